@@ -7,6 +7,10 @@
 
 #include "hyper.h"
 #include "earcut.hpp"
+#if CAP_THREAD
+#include <thread>
+#include <atomic>
+#endif
 
 namespace hr {
 
@@ -19,7 +23,8 @@ ld eyepos;
 
 #define revZ ((WDIM == 2 || hybri) ? -1 : 1)
 
-hyperpoint shcenter;
+/** the center used by add_cone and scaleshape; each thread building shapes has its own */
+thread_local hyperpoint shcenter;
 
 EX hyperpoint front_leg, rear_leg;
 EX transmatrix front_leg_move, rear_leg_move, front_leg_move_inverse, rear_leg_move_inverse;
@@ -331,6 +336,8 @@ void geometry_information::addtri(array<hyperpoint, 3> hs, int kind) {
 
 void disable(hpcshape& sh) {
   sh.s = sh.e = 0;
+  /* a disabled model should not be built lazily */
+  sh.flags &=~ POLY_LAZY;
   }
 
 void geometry_information::make_armor_3d(hpcshape& sh, int kind) { 
@@ -592,7 +599,7 @@ void geometry_information::make_revolution_cut(hpcshape &sh, int each, ld push,
     add_texture(shDogStripes);
     auto& utt = models_texture;
     int a = (6 * 360 / step);
-    for(int i=0; i<shDogStripes.e - shDogStripes.s; i++)
+    if(floor_textures) for(int i=0; i<shDogStripes.e - shDogStripes.s; i++)
       if(i % (2 * a) < a)
         utt.tvertices[i + shDogStripes.texture_offset][1] /= 4;
     }
@@ -776,7 +783,7 @@ void geometry_information::adjust_eye(hpcshape& eye, hpcshape head, ld shift_eye
     for(int i=eye.s; i<s; i++) {
       hpcpush(MirrorY * hpc[i]);
       auto& utt = models_texture;
-      utt.tvertices.push_back(utt.tvertices[i - eye.s + eye.texture_offset]);
+      if(floor_textures) utt.tvertices.push_back(utt.tvertices[i - eye.s + eye.texture_offset]);
       }
 
   finishshape();
@@ -833,6 +840,170 @@ void geometry_information::make_shadow(hpcshape& sh) {
   sh.she = isize(hpc);
   }
 
+bool same(const hyperpoint& h1, const hyperpoint& h2) {
+  return memcmp(&h1, &h2, sizeof(hyperpoint)) == 0;
+  }
+
+bool same(const hpcshape& a, const hpcshape& b) {
+  return a.s == b.s && a.e == b.e && a.prio == b.prio && a.flags == b.flags && same(a.intester, b.intester) && a.tinf == b.tinf
+    && a.texture_offset == b.texture_offset && a.shs == b.shs && a.she == b.she;
+  }
+
+/** the number of threads used to build the 3D models; 0 = as many as the hardware supports */
+EX int shape_threads = 0;
+
+/** build the jobs, in parallel if possible. Each thread builds its jobs in its own copy of this geometry_information,
+ *  then the vertices, texture vertices and shapes built by each job are appended in the order of the jobs,
+ *  so the result does not depend on the number of threads. The value of shcenter left at the end is the same
+ *  as if the jobs were run one after another.
+ */
+void geometry_information::build_in_parallel(const vector<shape_job>& jobs) {
+  finishshape();
+  hyperpoint center = shcenter, last_center = shcenter;
+  int threads = shape_threads;
+  #if CAP_THREAD
+  if(threads <= 0) threads = std::thread::hardware_concurrency();
+  #else
+  threads = 1;
+  #endif
+  /* product geometries switch the global geometry temporarily during the computations */
+  if(hybri) threads = 1;
+  threads = max(min(threads, isize(jobs)), 1);
+
+  if(threads == 1) {
+    for(auto& j: jobs) {
+      shcenter = center;
+      j.build(*this);
+      finishshape();
+      if(!same(shcenter, center)) last_center = shcenter;
+      }
+    shcenter = last_center;
+    return;
+    }
+
+  #if CAP_THREAD
+  /* the shapes declared directly in geometry_information, from shSemiFloorSide to shAnimatedBat2 */
+  auto first_shape = [] (geometry_information& g) { return &g.shSemiFloorSide[0]; };
+  int qshapes = (hpcshape*) (&shAnimatedBat2 + 1) - first_shape(*this);
+
+  struct part {
+    geometry_information *w;
+    int v0, v1, t0, t1, s0, s1, a0, a1;
+    vector<int> built;
+    hyperpoint center;
+    };
+  vector<part> parts(isize(jobs));
+  vector<unique_ptr<geometry_information>> workers(threads);
+  std::atomic<int> next(0);
+
+  auto work = [&] (int id) {
+    workers[id].reset(new geometry_information(*this));
+    auto& w = *workers[id];
+    /* the copied pointer refers to our shape, which is already finished */
+    w.last = nullptr;
+    auto sh = first_shape(w);
+    while(true) {
+      int i = next++;
+      if(i >= isize(jobs)) return;
+      auto& p = parts[i];
+      vector<hpcshape> before(sh, sh + qshapes);
+      p.w = &w;
+      p.v0 = isize(w.hpc); p.t0 = isize(w.models_texture.tvertices); p.s0 = isize(w.symmetriesAt); p.a0 = isize(w.allshapes);
+      shcenter = center;
+      jobs[i].build(w);
+      w.finishshape();
+      p.v1 = isize(w.hpc); p.t1 = isize(w.models_texture.tvertices); p.s1 = isize(w.symmetriesAt); p.a1 = isize(w.allshapes);
+      p.center = shcenter;
+      for(int k=0; k<qshapes; k++) if(!same(sh[k], before[k])) p.built.push_back(k);
+      }
+    };
+
+  vector<std::thread> ths;
+  for(int i=1; i<threads; i++) ths.emplace_back(work, i);
+  work(0);
+  for(auto& t: ths) t.join();
+
+  auto sh = first_shape(*this);
+  for(auto& p: parts) {
+    auto& w = *p.w;
+    int vshift = isize(hpc) - p.v0;
+    int tshift = isize(models_texture.tvertices) - p.t0;
+    hpc.insert(hpc.end(), w.hpc.begin() + p.v0, w.hpc.begin() + p.v1);
+    models_texture.tvertices.insert(models_texture.tvertices.end(), w.models_texture.tvertices.begin() + p.t0, w.models_texture.tvertices.begin() + p.t1);
+    for(int k=p.s0; k<p.s1; k++) {
+      auto a = w.symmetriesAt[k];
+      a[0] += vshift;
+      symmetriesAt.push_back(a);
+      }
+    for(int k: p.built) {
+      auto& s = sh[k];
+      s = first_shape(w)[k];
+      if(s.s >= p.v0) s.s += vshift, s.e += vshift;
+      if(s.shs >= p.v0) s.shs += vshift, s.she += vshift;
+      if(s.tinf == &w.models_texture) s.tinf = &models_texture, s.texture_offset += tshift;
+      }
+    for(int k=p.a0; k<p.a1; k++) {
+      char *a = (char*) w.allshapes[k];
+      if(a >= (char*) &w && a < (char*) (&w+1)) allshapes.push_back((hpcshape*) ((char*) this + (a - (char*) &w)));
+      }
+    if(!same(p.center, center)) last_center = p.center;
+    }
+  shcenter = last_center;
+  #endif
+  }
+
+/** build the 3D models of monsters and items only when they are drawn for the first time */
+EX bool lazy_models = true;
+
+/** the models are built eagerly when they are cached on disk (the cache stores all of them), and in product geometries, which would build them with the wrong geometry active */
+EX bool use_lazy_models() {
+  return lazy_models && !hybri && !shapecache::available();
+  }
+
+/** the jobs are run by require_model when one of their shapes is drawn; they should only read the vertices which exist now, and the shapes which are not changed later */
+void geometry_information::register_lazy(const vector<shape_job>& jobs) {
+  finishshape();
+  for(auto& j: jobs) {
+    int id = isize(lazy_models);
+    lazy_models.push_back(lazy_model{j, shcenter, false});
+    for(auto sh: j.shapes) {
+      sh->flags |= POLY_LAZY;
+      lazy_model_of[sh] = id;
+      }
+    }
+  }
+
+void geometry_information::require_model(const hpcshape& sh) {
+  if(!(sh.flags & POLY_LAZY)) return;
+  auto it = lazy_model_of.find(&sh);
+  if(it == lazy_model_of.end()) return;
+  auto& m = lazy_models[it->second];
+  if(m.built) return;
+  m.built = true;
+  /* the shape may have been replaced or disabled after the job was registered */
+  bool replaced = !(m.job.shapes[0]->flags & POLY_LAZY);
+  for(auto s: m.job.shapes) s->flags &=~ POLY_LAZY;
+  if(replaced) return;
+  DEBBI(DF_POLY, ("lazy model: ", m.job.name));
+  finishshape();
+  dynamicval<hyperpoint> dc(shcenter, m.center);
+  m.job.build(*this);
+  finishshape();
+  last = nullptr;
+  /* during prepare_shapes, initPolyForGL converts all the vertices later */
+  if(!ourshape.empty()) extra_vertices();
+  }
+
+EX int lazy_models_built() {
+  int res = 0;
+  for(auto& m: cgi.lazy_models) if(m.built) res++;
+  return res;
+  }
+
+void geometry_information::require_all_models() {
+  for(auto& m: lazy_models) require_model(*m.job.shapes[0]);
+  }
+
 void geometry_information::make_3d_models() {
   if(GDIM == 2 || noGUI) return;
   eyepos = WDIM == 2 ? 0.875 : 0.925;
@@ -857,64 +1028,47 @@ void geometry_information::make_3d_models() {
     for(int i=0; i<8; i++) make_shadow(shAsteroid[i]);
     }
     
-  DEBB(DF_POLY, ("humanoids"));
-  make_humanoid_3d(shPBody);
-  make_humanoid_3d(shYeti);
-  make_humanoid_3d(shFemaleBody);
-  make_humanoid_3d(shRaiderBody);
-  make_humanoid_3d(shSkeletonBody);
-  make_humanoid_3d(shFatBody);
-  make_humanoid_3d(shWaterElemental);
-  make_humanoid_3d(shJiangShi);
-  
+  /* the models are built in batches of independent jobs, see build_in_parallel; the vertices are added in the same order as if the jobs were run one after another.
+   * The batches after the humanoid bodies (which are almost always drawn, and whose final shcenter is used by the feet) are built lazily, see register_lazy.
+   */
+  vector<shape_job> jobs;
+  auto add = [&] (const string& name, const vector<hpcshape*>& shapes, const std::function<void(geometry_information&)>& f) { jobs.push_back(shape_job{name, shapes, f}); };
+  /* the shape of the builder w which corresponds to our shape sh */
+  auto at = [this] (geometry_information& w, hpcshape& sh) -> hpcshape& { return *(hpcshape*) ((char*) &w + ((char*) &sh - (char*) this)); };
+  bool lazy = use_lazy_models();
+  auto batch = [&] (const string& name, bool can_be_lazy) {
+    DEBB(DF_POLY, (name));
+    if(lazy && can_be_lazy)
+      shape_timing("3D models: " + name + " (lazy)", [&] { register_lazy(jobs); });
+    else
+      shape_timing("3D models: " + name, [&] { build_in_parallel(jobs); });
+    jobs.clear();
+    };
+
+  for(hpcshape *sh: {&shPBody, &shYeti, &shFemaleBody, &shRaiderBody, &shSkeletonBody, &shFatBody, &shWaterElemental, &shJiangShi})
+    add("humanoid", {sh}, [=] (geometry_information& w) { w.make_humanoid_3d(at(w, *sh)); });
+
+  batch("humanoids", false);
+
   // shFatBody = shPBody;
   // shFemaleBody = shPBody;
   // shRaiderBody = shPBody;
   // shJiangShi = shPBody;
 
-  DEBB(DF_POLY, ("heads"));
-  make_head_3d(shFemaleHair);
-  make_head_3d(shPHead);
-  make_head_3d(shTurban1);
-  make_head_3d(shTurban2);
-  make_head_3d(shAztecHead);
-  make_head_3d(shAztecCap);
-  make_head_3d(shVikingHelmet);
-  make_head_3d(shRaiderHelmet);
-  make_head_3d(shWestHat1);
-  make_head_3d(shWestHat2);
-  make_head_3d(shWitchHair);
-  make_head_3d(shBeautyHair);
-  make_head_3d(shFlowerHair);
-  make_head_3d(shGolemhead);
-  make_head_3d(shPirateHood);
-  make_head_3d(shEyepatch);
-  make_head_3d(shSkull);
-  make_head_3d(shDemon);
-  make_head_3d(shGoatHead);
-  make_head_3d(shJiangShiCap1);
-  make_head_3d(shJiangShiCap2);
-  make_head_3d(shTerraHead);
-  
-  DEBB(DF_POLY, ("armors"));
-  make_armor_3d(shKnightArmor);
-  make_armor_3d(shKnightCloak, 2);
-  make_armor_3d(shPrinceDress);
-  make_armor_3d(shPrincessDress, 2);
-  make_armor_3d(shTerraArmor1);
-  make_armor_3d(shTerraArmor2);
-  make_armor_3d(shTerraArmor3); 
-  make_armor_3d(shSuspenders); 
-  make_armor_3d(shJiangShiDress); 
-  make_armor_3d(shFemaleDress); 
-  make_armor_3d(shWightCloak, 2); 
-  make_armor_3d(shRaiderArmor); 
-  make_armor_3d(shRaiderShirt); 
-  make_armor_3d(shArmor); 
-  make_armor_3d(shRatCape2, 2); 
-  
-  make_armor_3d(shHood, 2);
-  
+  for(hpcshape *sh: {&shFemaleHair, &shPHead, &shTurban1, &shTurban2, &shAztecHead, &shAztecCap, &shVikingHelmet, &shRaiderHelmet,
+    &shWestHat1, &shWestHat2, &shWitchHair, &shBeautyHair, &shFlowerHair, &shGolemhead, &shPirateHood, &shEyepatch, &shSkull,
+    &shDemon, &shGoatHead, &shJiangShiCap1, &shJiangShiCap2, &shTerraHead})
+    add("head", {sh}, [=] (geometry_information& w) { w.make_head_3d(at(w, *sh)); });
+
+  for(auto p: vector<pair<hpcshape*, int>> {
+    {&shKnightArmor, 1}, {&shKnightCloak, 2}, {&shPrinceDress, 1}, {&shPrincessDress, 2}, {&shTerraArmor1, 1}, {&shTerraArmor2, 1},
+    {&shTerraArmor3, 1}, {&shSuspenders, 1}, {&shJiangShiDress, 1}, {&shFemaleDress, 1}, {&shWightCloak, 2}, {&shRaiderArmor, 1},
+    {&shRaiderShirt, 1}, {&shArmor, 1}, {&shRatCape2, 2}, {&shHood, 2}
+    })
+    add("armor", {p.first}, [=] (geometry_information& w) { w.make_armor_3d(at(w, *p.first), p.second); });
+
+  batch("heads and armors", true);
+
   DEBB(DF_POLY, ("feet and paws"));
   make_foot_3d(shHumanFoot);
   make_foot_3d(shYetiFoot);
@@ -932,102 +1086,147 @@ void geometry_information::make_3d_models() {
   rear_leg_move_inverse = inverse(rear_leg_move);
   leg_length = zc(0.4) - zc(0);
   
-  make_paw_3d(shWolfFrontPaw, shWolfFrontLeg);
-  make_paw_3d(shWolfRearPaw, shWolfRearLeg);
-  make_paw_3d(shDogFrontPaw, shDogFrontLeg);
-  make_paw_3d(shDogRearPaw, shDogRearLeg);  
+  auto paw = [&] (hpcshape& sh, hpcshape& legsh) {
+    /* the legs are disabled later, so a copy is used */
+    hpcshape leg = legsh;
+    add("paw", {&sh}, [=, &sh] (geometry_information& w) { hpcshape l = leg; w.make_paw_3d(at(w, sh), l); });
+    };
+  auto abody = [&] (hpcshape& sh, ld tail) {
+    add("body", {&sh}, [=, &sh] (geometry_information& w) { w.make_abody_3d(at(w, sh), tail); });
+    };
+  auto revolution = [&] (hpcshape& sh, int mx, ld push) {
+    add("revolution", {&sh}, [=, &sh] (geometry_information& w) { w.make_revolution(at(w, sh), mx, push); });
+    };
+  auto revolution_cut = [&] (hpcshape& sh, int each, ld push, ld width) {
+    vector<hpcshape*> shapes = {&sh};
+    if(&sh == &shDogTorso) shapes.push_back(&shDogStripes);
+    add("revolution", shapes, [=, &sh] (geometry_information& w) { w.make_revolution_cut(at(w, sh), each, push, width); });
+    };
+
+  paw(shWolfFrontPaw, shWolfFrontLeg);
+  paw(shWolfRearPaw, shWolfRearLeg);
+  paw(shDogFrontPaw, shDogFrontLeg);
+  paw(shDogRearPaw, shDogRearLeg);  
   
-  DEBB(DF_POLY, ("revolution"));
   // make_abody_3d(shWolfBody, 0.01);
   // make_ahead_3d(shWolfHead);
   // make_ahead_3d(shFamiliarHead);
   ld g = WDIM == 2 ? ABODY - zc(0.4) : 0;
   
-  make_revolution_cut(shWolfBody, 30, g, 0.01*S);
-  make_revolution_cut(shWolfHead, 180, AHEAD - ABODY +g);
-  make_revolution_cut(shRatHead, 180, AHEAD - ABODY +g, 0.04*scalefactor);
-  make_revolution_cut(shRatCape1, 180, AHEAD - ABODY +g);
-  make_revolution_cut(shFamiliarHead, 30, AHEAD - ABODY +g);
+  revolution_cut(shWolfBody, 30, g, 0.01*S);
+  revolution_cut(shWolfHead, 180, AHEAD - ABODY +g, 99);
+  revolution_cut(shRatHead, 180, AHEAD - ABODY +g, 0.04*scalefactor);
+  revolution_cut(shRatCape1, 180, AHEAD - ABODY +g, 99);
+  revolution_cut(shFamiliarHead, 30, AHEAD - ABODY +g, 99);
 
   // make_abody_3d(shDogTorso, 0.01);
-  make_revolution_cut(shDogTorso, 30, +g);
-  make_revolution_cut(shDogHead, 180, AHEAD - ABODY +g);
+  revolution_cut(shDogTorso, 30, +g, 99);
+  revolution_cut(shDogHead, 180, AHEAD - ABODY +g, 99);
   // make_ahead_3d(shDogHead);
 
   // make_abody_3d(shCatBody, 0.05);
   // make_ahead_3d(shCatHead);
-  make_revolution_cut(shCatBody, 30, +g);
-  make_revolution_cut(shCatHead, 180, AHEAD - ABODY +g, 0.055 * scalefactor);
+  revolution_cut(shCatBody, 30, +g, 99);
+  revolution_cut(shCatHead, 180, AHEAD - ABODY +g, 0.055 * scalefactor);
 
-  make_paw_3d(shReptileFrontFoot, shReptileFrontLeg);
-  make_paw_3d(shReptileRearFoot, shReptileRearLeg);  
-  make_abody_3d(shReptileBody, -1);
+  paw(shReptileFrontFoot, shReptileFrontLeg);
+  paw(shReptileRearFoot, shReptileRearLeg);  
+  abody(shReptileBody, -1);
   // make_ahead_3d(shReptileHead);
-  make_revolution_cut(shReptileHead, 180, AHEAD - ABODY+g);
+  revolution_cut(shReptileHead, 180, AHEAD - ABODY+g, 99);
 
-  make_paw_3d(shBullFrontHoof, shBullFrontHoof);
-  make_paw_3d(shBullRearHoof, shBullRearHoof);
+  paw(shBullFrontHoof, shBullFrontHoof);
+  paw(shBullRearHoof, shBullRearHoof);
   // make_abody_3d(shBullBody, 0.05);
   // make_ahead_3d(shBullHead);
   // make_ahead_3d(shBullHorn);
-  make_revolution_cut(shBullBody, 180, +g);
-  make_revolution_cut(shBullHead, 60, AHEAD - ABODY +g);
-  shift_shape(shBullHorn, -g-(AHEAD - ABODY));
+  revolution_cut(shBullBody, 180, +g, 99);
+  revolution_cut(shBullHead, 60, AHEAD - ABODY +g, 99);
   // make_revolution_cut(shBullHorn, 180, AHEAD - ABODY);
   
-  make_paw_3d(shTrylobiteFrontClaw, shTrylobiteFrontLeg);
-  make_paw_3d(shTrylobiteRearClaw, shTrylobiteRearLeg);
-  make_abody_3d(shTrylobiteBody, 0);
+  paw(shTrylobiteFrontClaw, shTrylobiteFrontLeg);
+  paw(shTrylobiteRearClaw, shTrylobiteRearLeg);
+  abody(shTrylobiteBody, 0);
   // make_ahead_3d(shTrylobiteHead);
-  make_revolution_cut(shTrylobiteHead, 180, AHEAD - ABODY +g);
+  revolution_cut(shTrylobiteHead, 180, AHEAD - ABODY +g, 99);
   
-  make_revolution_cut(shShark, 180, WDIM == 2 ? -FLOOR : 0);
+  revolution_cut(shShark, 180, WDIM == 2 ? -FLOOR : 0, 99);
 
-  make_revolution_cut(shGhost, 60, GHOST + g);
+  revolution_cut(shGhost, 60, GHOST + g, 99);
 
-  make_revolution_cut(shEagle, 180, 0, 0.05*S);
-  make_revolution_cut(shHawk, 180, 0, 0.05*S);
+  revolution_cut(shEagle, 180, 0, 0.05*S);
+  revolution_cut(shHawk, 180, 0, 0.05*S);
 
-  make_revolution_cut(shTinyBird, 180, 0, 0.025 * S);
-  make_revolution_cut(shTinyShark, 90);
-  make_revolution_cut(shMiniGhost, 60);
+  revolution_cut(shTinyBird, 180, 0, 0.025 * S);
+  revolution_cut(shTinyShark, 90, 0, 99);
+  revolution_cut(shMiniGhost, 60, 0, 99);
 
-  make_revolution_cut(shGargoyleWings, 180, 0, 0.05*S);
-  make_revolution_cut(shGargoyleBody, 180, 0, 0.05*S);
-  make_revolution_cut(shGadflyWing, 180, 0, 0.05*S);
-  make_revolution_cut(shBatWings, 180, 0, 0.05*S);
-  make_revolution_cut(shBatBody, 180, 0, 0.05*S);
+  revolution_cut(shGargoyleWings, 180, 0, 0.05*S);
+  revolution_cut(shGargoyleBody, 180, 0, 0.05*S);
+  revolution_cut(shGadflyWing, 180, 0, 0.05*S);
+  revolution_cut(shBatWings, 180, 0, 0.05*S);
+  revolution_cut(shBatBody, 180, 0, 0.05*S);
   
-  make_revolution_cut(shMouse, 180, -FLOOR);
-  shift_shape(shMouseLegs, FLOOR - human_height / 200);
+  revolution_cut(shMouse, 180, -FLOOR, 99);
 
-  make_revolution_cut(shJelly, 60);
-  make_revolution(shFoxTail1);
-  make_revolution(shFoxTail2);
-  make_revolution(shGadflyBody, 180, 0);
+  revolution_cut(shJelly, 60, 0, 99);
+  revolution(shFoxTail1, 180, 0);
+  revolution(shFoxTail2, 180, 0);
+  revolution(shGadflyBody, 180, 0);
   for(int i=0; i<8; i++)
-    make_revolution(shAsteroid[i], 360);
+    revolution(shAsteroid[i], 360, 0);
   
-  make_revolution_cut(shBugLeg, 60);
+  revolution_cut(shBugLeg, 60, 0, 99);
 
-  make_revolution(shBugArmor, 180, ABODY);
-  make_revolution_cut(shBugAntenna, 90, ABODY);
+  revolution(shBugArmor, 180, ABODY);
+  revolution_cut(shBugAntenna, 90, ABODY, 99);
   
-  make_revolution_cut(shButterflyBody, 180, 0);
-  make_revolution_cut(shButterflyWing, 180, 0, 0.05*S);
-  finishshape();
-  
-  DEBB(DF_POLY, ("animatebirds"));
-  animate_bird(shEagle, shAnimatedEagle, 0.05*S);
-  animate_bird(shTinyBird, shAnimatedTinyEagle, 0.05*S/2);
+  revolution_cut(shButterflyBody, 180, 0, 99);
+  revolution_cut(shButterflyWing, 180, 0, 0.05*S);
 
-  animate_bird(shButterflyWing, shAnimatedButterfly, 0);
-  animate_bird(shGadflyWing, shAnimatedGadfly, 0);
-  animate_bird(shHawk, shAnimatedHawk, 0.05*S);
-  animate_bird(shGargoyleWings, shAnimatedGargoyle, 0.05*S);
-  animate_bird(shGargoyleBody, shAnimatedGargoyle2, 0.05*S);
-  animate_bird(shBatWings, shAnimatedBat, 0.05*S);
-  animate_bird(shBatBody, shAnimatedBat2, 0.05*S);
+  batch("paws and revolution", true);
+
+  /* these only move the vertices of shapes not used by the jobs above */
+  shift_shape(shBullHorn, -g-(AHEAD - ABODY));
+  shift_shape(shMouseLegs, FLOOR - human_height / 200);
+  
+  auto bird = [&] (hpcshape& orig, hpcshape_animated& animated, ld body) {
+    vector<hpcshape*> shapes;
+    for(auto& sh: animated) shapes.push_back(&sh);
+    add("bird", shapes, [=, &orig, &animated] (geometry_information& w) {
+      w.require_model(at(w, orig));
+      auto& wanimated = *(hpcshape_animated*) &at(w, animated[0]);
+      w.animate_bird(at(w, orig), wanimated, body);
+      });
+    };
+  bird(shEagle, shAnimatedEagle, 0.05*S);
+  bird(shTinyBird, shAnimatedTinyEagle, 0.05*S/2);
+
+  bird(shButterflyWing, shAnimatedButterfly, 0);
+  bird(shGadflyWing, shAnimatedGadfly, 0);
+  bird(shHawk, shAnimatedHawk, 0.05*S);
+  bird(shGargoyleWings, shAnimatedGargoyle, 0.05*S);
+  bird(shGargoyleBody, shAnimatedGargoyle2, 0.05*S);
+  bird(shBatWings, shAnimatedBat, 0.05*S);
+  bird(shBatBody, shAnimatedBat2, 0.05*S);
+
+  revolution_cut(shDragonSegment, 60, g, 99);
+  revolution_cut(shDragonHead, 60, g, 99);
+  revolution_cut(shDragonTail, 60, g, 99);
+  revolution_cut(shWormSegment, 60, g, 99);
+  revolution_cut(shSmallWormSegment, 60, g, 99);
+  revolution_cut(shWormHead, 60, g, 99);
+  revolution_cut(shWormTail, 60, g, 99);
+  revolution_cut(shSmallWormTail, 60, g, 99);
+  revolution_cut(shTentHead, 60, g, 99);
+  revolution_cut(shKrakenHead, 60, -FLOOR, 99);
+  revolution_cut(shSeaTentacle, 60, -FLOOR, 99);
+  revolution_cut(shDragonLegs, 60, g, 99);
+  revolution_cut(shDragonWings, 60, g, 99);
+
+  add("head", {&shPHeadOnly}, [=] (geometry_information& w) { w.make_head_only(); });
+
+  batch("animated birds, dragons and worms", true);
 
   DEBB(DF_POLY, ("disablers"));
 
@@ -1041,23 +1240,7 @@ void geometry_information::make_3d_models() {
   disable(shTrylobiteRearLeg);
   disable(shPFace);
   disable(shJiangShi);
-  
-  make_revolution_cut(shDragonSegment, 60, g);
-  make_revolution_cut(shDragonHead, 60, g);
-  make_revolution_cut(shDragonTail, 60, g);
-  make_revolution_cut(shWormSegment, 60, g);
-  make_revolution_cut(shSmallWormSegment, 60, g);
-  make_revolution_cut(shWormHead, 60, g);
-  make_revolution_cut(shWormTail, 60, g);
-  make_revolution_cut(shSmallWormTail, 60, g);
-  make_revolution_cut(shTentHead, 60, g);
-  make_revolution_cut(shKrakenHead, 60, -FLOOR);
-  make_revolution_cut(shSeaTentacle, 60, -FLOOR);
-  make_revolution_cut(shDragonLegs, 60, g);
-  make_revolution_cut(shDragonWings, 60, g);
   disable(shDragonNostril);
-
-  make_head_only();
   
   DEBB(DF_POLY, ("balls"));
   make_ball(shDisk, orbsize*.2, 2);
@@ -1137,6 +1320,9 @@ void geometry_information::make_3d_models() {
   shift_shape(shMagicShovel, ABODY);
   
   DEBB(DF_POLY, ("eyes"));
+  /* the eyes are placed on the heads, and they set the eye levels, so they are not lazy */
+  for(hpcshape *sh: {&shGhost, &shMiniGhost, &shWormHead, &shDragonHead, &shKrakenHead, &shDogHead, &shWolfHead, &shRatHead, &shReptileHead, &shGadflyBody, &shPHeadOnly, &shMouse})
+    require_model(*sh);
   adjust_eye(shSlimeEyes, shSlime, FLATEYE, 0, 2, 2);
   adjust_eye(shGhostEyes, shGhost, GHOST, GHOST, 2, WDIM == 2 ? 2 : 4);
   adjust_eye(shMiniEyes, shMiniGhost, GHOST, GHOST, 2, 2);
@@ -1220,6 +1406,134 @@ void geometry_information::make_3d_models() {
   finishshape();
   }
 
+/** build the shapes of the current geometry from scratch, in a new geometry_information */
+/** run f with g as the current geometry_information */
+void with_shapes(geometry_information& g, const reaction_t& f) {
+  {
+  dynamicval<geometry_information*> dc(cgip, &g);
+  f();
+  }
+  /* the shapes of g may have been sent to the GPU */
+  glhr::store_in_buffer(cgi.ourshape);
+  glhr::current_vertices = NULL;
+  }
+
+/** build the shapes of the current geometry from scratch, in a new geometry_information */
+unique_ptr<geometry_information> build_fresh_shapes(int threads, bool lazy) {
+  dynamicval<int> dt(shape_threads, threads);
+  dynamicval<bool> dl(lazy_models, lazy);
+  dynamicval<string> ds(shapecache::dir, "");
+  unique_ptr<geometry_information> g(new geometry_information);
+  /* clear the shapes, so that the ones which are not built can be compared too */
+  for(hpcshape *sh = &g->shSemiFloorSide[0]; sh != (hpcshape*) (&g->shAnimatedBat2 + 1); sh++) *sh = hpcshape(), sh->intester = Hypc;
+  with_shapes(*g, [] {
+    srand(1);
+    cgi.require_basics();
+    cgi.require_shapes();
+    });
+  return g;
+  }
+
+/** the memory used by the vertices of the shapes, in bytes */
+size_t shape_memory(geometry_information& g) {
+  return g.hpc.capacity() * sizeof(hyperpoint) + g.ourshape.capacity() * sizeof(glvertex) + g.models_texture.tvertices.capacity() * sizeof(glvertex);
+  }
+
+EX void shape_benchmark() {
+  for(bool lazy: {false, true}) {
+    auto t0 = profile_clock();
+    auto g = build_fresh_shapes(shape_threads, lazy);
+    println(hlog, lazy ? "lazy" : "eager", " models: shapes built in ", (profile_clock() - t0) / 1e6, " ms (", isize(g->hpc), " vertices, ",
+      int(shape_memory(*g) >> 10), " KB, ", shape_threads, " threads)");
+    for(auto& p: shape_build_times) println(hlog, format("  %-50s %8.2f ms", p.first.c_str(), double(p.second)));
+    if(!lazy) continue;
+    t0 = profile_clock();
+    with_shapes(*g, [&] { g->require_all_models(); });
+    println(hlog, "lazy models: all ", isize(g->lazy_models), " models built in ", (profile_clock() - t0) / 1e6, " ms (", isize(g->hpc), " vertices, ", int(shape_memory(*g) >> 10), " KB)");
+    }
+  if(use_lazy_models()) println(hlog, "current game: ", lazy_models_built(), " of ", isize(cgi.lazy_models), " lazy models built, ", int(shape_memory(cgi) >> 10), " KB");
+  }
+
+void test_parallel_shapes() {
+  if(GDIM == 2 || noGUI) return;
+  /* the shapes are sent to the GPU, so the video mode needs to be set */
+  #if CAP_SDL
+  if(!s) return;
+  #endif
+  println(hlog, "Testing build_in_parallel...");
+  auto g1 = build_fresh_shapes(1, false);
+  auto g4 = build_fresh_shapes(4, false);
+  bool ok = isize(g1->hpc) == isize(g4->hpc) && memcmp(&g1->hpc[0], &g4->hpc[0], isize(g1->hpc) * sizeof(hyperpoint)) == 0;
+  ok = ok && isize(g1->models_texture.tvertices) == isize(g4->models_texture.tvertices);
+  hpcshape *sh1 = &g1->shSemiFloorSide[0], *sh4 = &g4->shSemiFloorSide[0];
+  int qshapes = (hpcshape*) (&g1->shAnimatedBat2 + 1) - sh1;
+  for(int k=0; k<qshapes; k++) {
+    hpcshape a = sh1[k];
+    if(a.tinf == &g1->models_texture) a.tinf = &g4->models_texture;
+    if(same(a, sh4[k])) continue;
+    println(hlog, "shape ", k, " differs: ", sh1[k].s, "-", sh1[k].e, " vs ", sh4[k].s, "-", sh4[k].e);
+    ok = false;
+    break;
+    }
+  if(!ok) println(hlog, "Failed: the shapes built in parallel differ from the shapes built serially");
+  }
+
+int parallel_shape_tester = addHook(hooks_tests, 0, test_parallel_shapes);
+
+void test_lazy_models() {
+  if(GDIM == 2 || noGUI || hybri) return;
+  #if CAP_SDL
+  if(!s) return;
+  #endif
+  println(hlog, "Testing lazy models...");
+  auto ge = build_fresh_shapes(1, false);
+  auto gl = build_fresh_shapes(1, true);
+  with_shapes(*gl, [&] { gl->require_all_models(); });
+  /* the vertices are in a different order, but each shape should consist of the same vertices */
+  auto range_differs = [] (const vector<hyperpoint>& v1, int s1, const vector<hyperpoint>& v2, int s2, int q) {
+    return q && memcmp(&v1[s1], &v2[s2], q * sizeof(hyperpoint));
+    };
+  hpcshape *sh1 = &ge->shSemiFloorSide[0], *sh2 = &gl->shSemiFloorSide[0];
+  int qshapes = (hpcshape*) (&ge->shAnimatedBat2 + 1) - sh1;
+  for(int k=0; k<qshapes; k++) {
+    auto& a = sh1[k];
+    auto& b = sh2[k];
+    bool textured = a.tinf == &ge->models_texture;
+    bool bad = a.e - a.s != b.e - b.s || a.flags != b.flags || a.prio != b.prio || !same(a.intester, b.intester);
+    bad = bad || range_differs(ge->hpc, a.s, gl->hpc, b.s, a.e - a.s);
+    bad = bad || textured != (b.tinf == &gl->models_texture);
+    if(!bad && textured) for(int i=0; i<a.e-a.s; i++)
+      if(memcmp(&ge->models_texture.tvertices[a.texture_offset+i], &gl->models_texture.tvertices[b.texture_offset+i], sizeof(glvertex))) bad = true;
+    if(bad) {
+      println(hlog, "Failed: shape ", k, " differs when built lazily");
+      return;
+      }
+    }
+  }
+
+int lazy_model_tester = addHook(hooks_tests, 0, test_lazy_models);
+
+#if CAP_COMMANDLINE
+int read_shape_args() {
+  using namespace arg;
+  if(0) ;
+  else if(argis("-lazy-models")) {
+    shift(); lazy_models = argi();
+    }
+  else if(argis("-shape-threads")) {
+    shift(); shape_threads = argi();
+    }
+  else if(argis("-bench-shapes")) {
+    PHASE(3); start_game();
+    shape_benchmark();
+    }
+  else return 1;
+  return 0;
+  }
+
+auto ahs = addHook(hooks_args, 0, read_shape_args);
+#endif
+
 #undef S
 #undef SH
 #undef revZ
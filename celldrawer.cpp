@@ -1,6 +1,22 @@
 #include "hyper.h"
 namespace hr {
 
+/** level of detail: cells whose size in pixels (as given by scale_in_pixels at their center) is below
+ *  these thresholds are drawn in less detail; the cell the player is on is always drawn fully */
+EX namespace lod {
+  EX bool on = false;
+  /** monsters and items are drawn as glyphs, as in the ASCII mode */
+  EX ld impostor_size = 12;
+  /** special floor shapes are replaced with the plain full floor */
+  EX ld simple_floor_size = 8;
+  /** polygons are drawn without outlines */
+  EX ld outline_size = 6;
+  /** monsters and items are not drawn at all */
+  EX ld skip_size = 3;
+  /** set while drawing a cell below outline_size */
+  EX bool no_outlines;
+  EX }
+
 #if HDR
 int coastvalEdge(cell *c);
 
@@ -17,6 +33,8 @@ struct celldrawer {
   int ct6;
   bool error;
   bool onradar;
+  /** the size used for the level of detail */
+  ld lod_size;
   char asciichar;
   transmatrix Vboat;
   transmatrix Vd;
@@ -1920,6 +1938,13 @@ void celldrawer::draw_wall_full() {
     
     else set_land_floor(Vf);
 
+    if(lod_size < lod::simple_floor_size && c->wall == waNone && !chasmg && !sl && qfi.fshape && qfi.usershape < 0
+      #if CAP_TEXTURE
+      && !qfi.tinf
+      #endif
+      )
+      set_floor(cgi.shFullFloor);
+
     // actually draw the floor
 
     if(chasmg == 2) ;
@@ -2365,6 +2390,7 @@ void celldrawer::draw() {
   if(hybrid::pmap) { product::drawcell_stack(cw, V); return; }
 
   cells_drawn++;
+  profile_scope ps(prof_cells);
 
 #if CAP_TEXTURE
   if(texture::saving) {
@@ -2425,6 +2451,9 @@ void celldrawer::draw() {
     #endif
     fd = getfd(c);
     error = false;
+
+    lod_size = lod::on && !inHighQual && !isPlayerOn(c) ? scale_in_pixels(V) : 1e9;
+    dynamicval<bool> dno(lod::no_outlines, lod_size < lod::outline_size);
     
     setcolors();
     
@@ -2466,8 +2495,16 @@ void celldrawer::draw() {
     draw_wall_full();
 #endif    
 
-    draw_item_full();
-    draw_monster_full();
+    if(lod_size < lod::skip_size) ;
+    else if(lod_size < lod::impostor_size) {
+      dynamicval<bool> dm(mmmon, false), di(mmitem, false);
+      draw_item_full();
+      draw_monster_full();
+      }
+    else {
+      draw_item_full();
+      draw_monster_full();
+      }
       
 #if CAP_TEXTURE    
     if(!texture::using_aura()) 
@@ -485,6 +485,12 @@ EX void initConfig() {
   #endif
   
   addsaver(vid.linequality, "line quality", 0);
+  addsaver(lod::on, "level of detail", false);
+  addsaver(lod::impostor_size, "lod-impostor-size", 12);
+  addsaver(lod::simple_floor_size, "lod-simple-floor-size", 8);
+  addsaver(lod::outline_size, "lod-outline-size", 6);
+  addsaver(lod::skip_size, "lod-skip-size", 3);
+  addsaver(governor::target_ms, "frame budget", 0);
   
   #if CAP_FILES && CAP_SHOT && CAP_ANIMATIONS
   addsaver(anims::animfile, "animation file format");
@@ -1029,6 +1035,9 @@ EX void showGraphConfig() {
     mouseovers = XLAT("Reduce the framerate limit to conserve CPU energy");
   #endif
 
+  dialog::addSelItem(XLAT("frame budget"), governor::target_ms ? its(governor::target_ms) + " ms" : ONOFF(false), 'g');
+  dialog::addBoolItem(XLAT("simplify distant cells"), lod::on, 'd');
+
 #if !ISIOS && !ISWEB
   dialog::addBoolItem(XLAT("fullscreen mode"), (vid.full), 'f');
 #endif
@@ -1102,6 +1111,15 @@ EX void showGraphConfig() {
         XLAT("Higher numbers make the curved lines smoother, but reduce the performance."));
       }
   
+    else if(xuni == 'd') lod::on = !lod::on;
+
+    else if(xuni == 'g') {
+      dialog::editNumber(governor::target_ms, 0, 200, 5, 33, XLAT("frame budget"), 
+        XLAT("When drawing the map takes longer than this many milliseconds, the sight range, the detail and the line quality "
+        "are reduced automatically, and restored when it becomes fast again. 0 turns this off."));
+      dialog::reaction = governor::reset;
+      }
+
   #if CAP_FRAMELIMIT    
     else if(xuni == 'l') {
       dialog::editNumber(vid.framelimit, 5, 300, 10, 300, XLAT("framerate limit"), "");
@@ -2365,6 +2383,16 @@ EX int read_config_args() {
   else if(argis("-vlq")) { 
     PHASEFROM(2); shift(); vid.linequality = argi();
     }
+  else if(argis("-lod")) { 
+    PHASEFROM(2); shift(); lod::on = argi();
+    }
+  else if(argis("-lodsizes")) { 
+    PHASEFROM(2); lod::on = true;
+    shift_arg_formula(lod::impostor_size);
+    shift_arg_formula(lod::simple_floor_size);
+    shift_arg_formula(lod::outline_size);
+    shift_arg_formula(lod::skip_size);
+    }
   else if(argis("-fov")) { 
     PHASEFROM(2); shift_arg_formula(vid.fov);
     }
@@ -1,341 +1,813 @@
-// This generates the inverse geodesics tables.
-
-// Usage: 
-
-// [executable] -geo sol -write solv-geodesics.dat
-//              -geo 3:2 -write shyp-geodesics.dat
-//              -geo 3:1/2 -write ssol-geodesics.dat
-//              -exit
-
-// You can also do -geo [...] -build to build and test the table
-// without writing it.
-
-// By default this generates 64x64x64 tables.
-// Add e.g. '-dim 128 128 128' before -write to generate
-// a more/less precise table.
-
-#include "../hyper.h"
-
-#include <thread>
-#include <mutex>
-
-namespace hr {
-
-transmatrix parabolic1(ld u);
-
-namespace nisot {
-
-typedef hyperpoint pt;
-
-using solnihv::x_to_ix;
-
-ld z_to_iz(ld z) { if(sol) return tanh(z); else return tanh(z/4)/2 + .5; }
-
-ptlow be_low(hyperpoint x) { return ptlow({float(x[0]), float(x[1]), float(x[2])}); }
-
-template<class T> void parallelize(int threads, int Nmin, int Nmax, T action) {
-  std::vector<std::thread> v;
-  for(int k=0; k<threads; k++)
-    v.emplace_back([&,k] () { 
-      for(int i=Nmin+k; i < Nmax; i += threads) action(k, i);
-      });
-  for(std::thread& t:v) t.join();
-  }
-
-ld solerror(hyperpoint ok, hyperpoint chk) {
-  auto zok  = point3( x_to_ix(ok[0]), x_to_ix(ok[1]), z_to_iz(ok[2]) );
-  auto zchk = point3( x_to_ix(chk[0]), x_to_ix(chk[1]), z_to_iz(chk[2]) );
-  return hypot_d(3, zok - zchk);
-  }
-
-hyperpoint iterative_solve(hyperpoint xp, hyperpoint candidate, int prec, ld minerr, bool debug = false) {
-
-  transmatrix T = Id; T[0][1] = 8; T[2][2] = 5;
-  
-  auto f = [&] (hyperpoint x) { return nisot::numerical_exp(x, prec); }; // T * x; };
-
-  auto ver = f(candidate);
-  ld err = solerror(xp, ver);
-  auto at = candidate;
-  
-  ld eps = 1e-6;
-
-  hyperpoint c[3];  
-  for(int a=0; a<3; a++) c[a] = point3(a==0, a==1, a==2);
-  
-  while(err > minerr) {
-    if(debug) println(hlog, "\n\nf(", at, "?) = ", ver, " (error ", err, ")");
-    array<hyperpoint, 3> pnear;
-    for(int a=0; a<3; a++) {
-      auto x = at + c[a] * eps;
-      if(debug) println(hlog, "f(", x, ") = ", f(x), " = y + ", f(x)-ver );
-      pnear[a] = (f(x) - ver) / eps; //  (direct_exp(at + c[a] * eps, prec) - ver) / eps;
-      }
-    
-    transmatrix U = Id;
-    for(int a=0; a<3; a++) 
-    for(int b=0; b<3; b++)
-      U[a][b] = pnear[b][a];
-
-    hyperpoint diff = (xp - ver);
-    
-    hyperpoint bonus = inverse(U) * diff;
-    
-    if(hypot_d(3, bonus) > 0.1) bonus = bonus * 0.1 / hypot_d(3, bonus);
-    
-    int fixes = 0;
-    
-    if(debug) 
-      println(hlog, "\nU = ", U, "\ndiff = ", diff, "\nbonus = ", bonus, "\n");
-    
-    nextfix:
-    hyperpoint next = at + bonus;
-    hyperpoint nextver = f(next);
-    ld nexterr = solerror(xp, nextver);
-    if(debug) println(hlog, "f(", next, ") = ", nextver, ", error = ", nexterr);
-    
-    if(nexterr < err) {
-      // println(hlog, "reduced error ", err, " to ", nexterr);
-      at = next;
-      ver = nextver;
-      err = nexterr;
-      continue;
-      }
-    else {
-      bonus /= 2;
-      fixes++;
-      if(fixes > 10) {
-        if(err > 999) {
-          for(ld s = 1; abs(s) > 1e-9; s *= 0.5)
-          for(int k=0; k<27; k++) {
-            int kk = k;
-            next = at;
-            for(int i=0; i<3; i++) { if(kk%3 == 1) next[i] += s; if(kk%3 == 2) next[i] -= s; kk /= 3; }
-            // next = at + c[k] * s;
-            nextver = f(next);
-            nexterr = solerror(xp, nextver);
-            // println(hlog, "f(", next, ") = ", nextver, ", error = ", nexterr);
-            if(nexterr < err) { at = next; ver = nextver; err = nexterr; goto nextiter; }
-            }
-            println(hlog, "cannot improve error ", err);
-            exit(1);
-          }
-        break;
-        }
-      goto nextfix;
-      }
-    
-    nextiter: ;
-    }
-  
-  return at;
-  }
-
-ptlow mlow(ld x, ld y, ld z) { return ptlow({float(x), float(y), float(z)}); }
-
-hyperpoint atxyz(ld x, ld y, ld z) { return hyperpoint({x, y, z, 1}); }
-
-ptlow operator +(ptlow a, ptlow b) { return mlow(a[0]+b[0], a[1]+b[1], a[2]+b[2]); }
-ptlow operator -(ptlow a, ptlow b) { return mlow(a[0]-b[0], a[1]-b[1], a[2]-b[2]); }
-ptlow operator *(ptlow a, ld x) { return mlow(a[0]*x, a[1]*x, a[2]*x); }
-
-ptlow can(hyperpoint x) {
-  // azimuthal equidistant to Klein
-  ld r = sqrt(x[0] * x[0] + x[1] * x[1] + x[2] * x[2]);
-  if(r == 0) return mlow(0,0,0);
-  ld make_r = tanh(r);
-  ld d = make_r / r;
-  return mlow(x[0]*d, x[1]*d, x[2]*d);
-  }
-
-hyperpoint uncan(ptlow x) {
-  ld r = sqrt(x[0] * x[0] + x[1] * x[1] + x[2] * x[2]);
-  if(r == 0) return atxyz(0,0,0);
-  ld make_r = atanh(r);
-  if(r == 1) make_r = 30;
-  ld d = make_r / r;
-  return atxyz(x[0]*d, x[1]*d, x[2]*d);
-  }
-
-hyperpoint uncan_info(ptlow x) {
-  ld r = sqrt(x[0] * x[0] + x[1] * x[1] + x[2] * x[2]);
-  println(hlog, "r = ", r);
-  if(r == 0) return atxyz(0,0,0);
-  ld make_r = atanh(r);
-  println(hlog, "make_r = ", make_r);
-  ld d = make_r / r;
-  println(hlog, "d = ", d);
-  return atxyz(x[0]*d, x[1]*d, x[2]*d);
-  }
-
-void fint(FILE *f, int x) { fwrite(&x, sizeof(x), 1, f); }
-void ffloat(FILE *f, float x) { fwrite(&x, sizeof(x), 1, f); }
-
-void write_table(solnihv::tabled_inverses& tab, const char *fname) {
-  FILE *f = fopen(fname, "wb");
-  fint(f, tab.PRECX);
-  fint(f, tab.PRECY);
-  fint(f, tab.PRECZ);
-  fwrite(&tab.tab[0], sizeof(ptlow) * tab.PRECX * tab.PRECY * tab.PRECZ, 1, f);
-  fclose(f);
-  }
-
-void alloc_table(solnihv::tabled_inverses& tab, int X, int Y, int Z) {
-  tab.PRECX = X;
-  tab.PRECY = Y;
-  tab.PRECZ = Z;
-  tab.tab.resize(X*Y*Z);
-  }
-
-ld ix_to_x(ld ix) {
-  ld minx = 0, maxx = 1;
-  for(int it=0; it<100; it++) {
-    ld x = (minx + maxx) / 2;
-    if(x_to_ix(atanh(x)) < ix) minx = x;
-    else maxx = x;
-    }
-  return atanh(minx);
-  }
-
-ld iz_to_z(ld z) {
-  return nih ? atanh(z * 2 - 1)*4 : atanh(z); // atanh(z * 2 - 1);
-  }
-
-ld ptd(ptlow p) {
-  return p[0]*p[0] + p[1]*p[1] + p[2] * p[2];
-  }
-
-ptlow zflip(ptlow x) { return mlow(x[1], x[0], -x[2]); }
-
-void build_sols(int PRECX, int PRECY, int PRECZ) {
-  std::mutex file_mutex;
-  ld max_err = 0;
-  auto& tab = solnihv::get_tabled();
-  alloc_table(tab, PRECX, PRECY, PRECZ);
-  int last_x = PRECX-1, last_y = PRECY-1, last_z = PRECZ-1;
-  auto act = [&] (int tid, int iz) {
-    if((nih && iz == 0) || iz == PRECZ-1) return;
-  
-    auto solve_at = [&] (int ix, int iy) {
-      ld x = ix_to_x(ix / (PRECX-1.));
-      ld y = ix_to_x(iy / (PRECY-1.));
-      ld z = iz_to_z(iz / (PRECZ-1.));
-      
-      auto v = hyperpoint ({x,y,z,1});
-      
-      vector<hyperpoint> candidates;
-      hyperpoint cand;
-      
-      candidates.push_back(atxyz(0,0,0)); 
-      
-      static constexpr int prec = 100;
-      
-      // sort(candidates.begin(), candidates.end(), [&] (hyperpoint a, hyperpoint b) { return solerror(v, direct_exp(a, prec)) > solerror(v, direct_exp(b, prec)); });
-      
-      // cand_best = candidates.back();
-      
-      vector<hyperpoint> solved_candidates;
-      
-      for(auto c: candidates)  {
-        auto solt = iterative_solve(v, c, prec, 1e-6);
-        solved_candidates.push_back(solt);
-        if(solerror(v, nisot::numerical_exp(solt, prec)) < 1e-9) break;
-        }
-
-      sort(solved_candidates.begin(), solved_candidates.end(), [&] (hyperpoint a, hyperpoint b) { return solerror(v, nisot::numerical_exp(a, prec)) > solerror(v, nisot::numerical_exp(b, prec)); });
-      
-      cand = solved_candidates.back();
-
-      auto xerr = solerror(v, nisot::numerical_exp(cand, prec));
-      
-      if(xerr > 1e-3) {
-        println(hlog, format("[%2d %2d %2d] ", iz, iy, ix));
-        println(hlog, "f(?) = ", v);
-        println(hlog, "f(", cand, ") = ", nisot::numerical_exp(cand, prec));
-        println(hlog, "error = ", xerr);
-        println(hlog, "canned = ", can(cand));
-        max_err = xerr;
-        /*
-        hyperpoint h1 = uncan(solution[iz][iy-1][ix]);
-        hyperpoint h2 = uncan(solution[iz][iy][ix-1]);
-        hyperpoint h3 = uncan(solution[iz][iy-1][ix-1]);
-        hyperpoint h4 = h1 + h2 - h3;
-        solution[iz][iy][ix] = can(h4);
-        */
-        return;
-        }
-
-      auto& so = tab.get_int(ix, iy, iz);
-
-      so = can(cand);
-      
-      
-      for(int z=0; z<3; z++) if(isnan(so[z]) || isinf(so[z])) {
-        println(hlog, cand, "canned to ", so);
-        exit(4);
-        }
-      };
-    
-    for(int it=0; it<max(last_x, last_y); it++) {
-      for(int a=0; a<it; a++) {
-        if(it < last_x && a < last_y) solve_at(it, a);
-        if(a < last_x && it < last_y) solve_at(a, it);
-        }
-      if(it < last_x && it < last_y) solve_at(it, it);
-      std::lock_guard<std::mutex> fm(file_mutex);
-      println(hlog, format("%2d: %2d", iz, it));
-      }
-    };
-
-  parallelize(PRECZ, 0, PRECZ, act);
-  
-  for(int x=0; x<last_x; x++)
-  for(int y=0; y<last_y; y++) {
-    for(int z=last_z; z<PRECZ; z++)
-      tab.get_int(x,y,z) = tab.get_int(x,y,z-1) * 2 - tab.get_int(x,y,z-2);
-    if(nih)
-      tab.get_int(x,y,0) = tab.get_int(x,y,1) * 2 - tab.get_int(x,y,2);
-    }
-  
-  for(int x=0; x<last_x; x++)
-  for(int y=last_y; y<PRECY; y++)
-  for(int z=0; z<PRECZ; z++)
-    tab.get_int(x,y,z) = tab.get_int(x,y-1,z) * 2 - tab.get_int(x,y-2,z);
-  
-  for(int x=last_x; x<PRECX; x++)
-  for(int y=0; y<PRECY; y++)
-  for(int z=0; z<PRECZ; z++)
-    tab.get_int(x,y,z) = tab.get_int(x-1,y,z) * 2 - tab.get_int(x-2,y,z);
-  }
-
-int dimX, dimY, dimZ;
-
-int readArgs() {
-  using namespace arg;
-           
-  if(0) ;
-  else if(argis("-dim")) {
-    PHASEFROM(2); 
-    shift(); dimX = argi();
-    shift(); dimY = argi();
-    shift(); dimZ = argi();
-    }
-  else if(argis("-build")) {
-    PHASEFROM(2); 
-    build_sols(dimX, dimY, dimZ);
-    }
-  else if(argis("-write")) {
-    PHASEFROM(2); 
-    shift();
-    build_sols(dimX, dimY, dimZ);
-    write_table(solnihv::get_tabled(), argcs());
-    }
-
-  else return 1;
-  return 0;
-  }
-
-auto hook = addHook(hooks_args, 100, readArgs);
-
-}
-}
+// This generates the inverse geodesics tables.
+
+// Usage: 
+
+// [executable] -geo sol -write solv-geodesics.dat
+//              -geo 3:2 -write shyp-geodesics.dat
+//              -geo 3:1/2 -write ssol-geodesics.dat
+//              -exit
+
+// You can also do -geo [...] -build to build and test the table
+// without writing it.
+
+// By default this generates 64x64x64 tables.
+// Add e.g. '-dim 128 128 128' before -write to generate
+// a more/less precise table.
+
+// The table is written in the format set by '-geodesics-format half|float 0|1'
+// (the last parameter is block compression), half-float uncompressed by default.
+
+// The table is computed by all the hardware threads ('-table-threads N' to change).
+// The progress is saved every minute to [file].ckpt, and a new -write with the same
+// geometry and dimensions continues from there ('-table-checkpoint file seconds' to change;
+// with -build, there is no checkpoint unless given).
+
+#include "../hyper.h"
+
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+namespace hr {
+
+transmatrix parabolic1(ld u);
+
+namespace nisot {
+
+typedef hyperpoint pt;
+
+using solnihv::x_to_ix;
+
+ld z_to_iz(ld z) { if(sol) return tanh(z); else return tanh(z/4)/2 + .5; }
+
+ptlow be_low(hyperpoint x) { return ptlow({float(x[0]), float(x[1]), float(x[2])}); }
+
+ld solerror(hyperpoint ok, hyperpoint chk) {
+  auto zok  = point3( x_to_ix(ok[0]), x_to_ix(ok[1]), z_to_iz(ok[2]) );
+  auto zchk = point3( x_to_ix(chk[0]), x_to_ix(chk[1]), z_to_iz(chk[2]) );
+  return hypot_d(3, zok - zchk);
+  }
+
+/** Newton's method, starting from candidate, for at most max_iterations; the error reached and the number of iterations are returned in final_err and iterations */
+hyperpoint iterative_solve(hyperpoint xp, hyperpoint candidate, int prec, ld minerr, int max_iterations, int& iterations, ld& final_err, bool debug = false) {
+
+  transmatrix T = Id; T[0][1] = 8; T[2][2] = 5;
+  
+  auto f = [&] (hyperpoint x) { return nisot::numerical_exp(x, prec); }; // T * x; };
+
+  auto ver = f(candidate);
+  ld err = solerror(xp, ver);
+  auto at = candidate;
+  
+  ld eps = 1e-6;
+
+  hyperpoint c[3];  
+  for(int a=0; a<3; a++) c[a] = point3(a==0, a==1, a==2);
+  
+  while(err > minerr && iterations < max_iterations) {
+    iterations++;
+    if(debug) println(hlog, "\n\nf(", at, "?) = ", ver, " (error ", err, ")");
+    array<hyperpoint, 3> pnear;
+    /* the three numerical derivatives are computed in one batch */
+    hyperpoint xs[3], ys[3];
+    for(int a=0; a<3; a++) xs[a] = at + c[a] * eps;
+    nisot::numerical_exp_batch(xs, ys, 3, prec);
+    for(int a=0; a<3; a++) {
+      if(debug) println(hlog, "f(", xs[a], ") = ", ys[a], " = y + ", ys[a]-ver );
+      pnear[a] = (ys[a] - ver) / eps; //  (direct_exp(at + c[a] * eps, prec) - ver) / eps;
+      }
+    
+    transmatrix U = Id;
+    for(int a=0; a<3; a++) 
+    for(int b=0; b<3; b++)
+      U[a][b] = pnear[b][a];
+
+    hyperpoint diff = (xp - ver);
+    
+    hyperpoint bonus = inverse(U) * diff;
+    
+    if(hypot_d(3, bonus) > 0.1) bonus = bonus * 0.1 / hypot_d(3, bonus);
+    
+    int fixes = 0;
+    
+    if(debug) 
+      println(hlog, "\nU = ", U, "\ndiff = ", diff, "\nbonus = ", bonus, "\n");
+    
+    nextfix:
+    hyperpoint next = at + bonus;
+    hyperpoint nextver = f(next);
+    ld nexterr = solerror(xp, nextver);
+    if(debug) println(hlog, "f(", next, ") = ", nextver, ", error = ", nexterr);
+    
+    if(nexterr < err) {
+      // println(hlog, "reduced error ", err, " to ", nexterr);
+      at = next;
+      ver = nextver;
+      err = nexterr;
+      continue;
+      }
+    else {
+      bonus /= 2;
+      fixes++;
+      if(fixes > 10) {
+        if(err > 999) {
+          for(ld s = 1; abs(s) > 1e-9; s *= 0.5)
+          for(int k=0; k<27; k++) {
+            int kk = k;
+            next = at;
+            for(int i=0; i<3; i++) { if(kk%3 == 1) next[i] += s; if(kk%3 == 2) next[i] -= s; kk /= 3; }
+            // next = at + c[k] * s;
+            nextver = f(next);
+            nexterr = solerror(xp, nextver);
+            // println(hlog, "f(", next, ") = ", nextver, ", error = ", nexterr);
+            if(nexterr < err) { at = next; ver = nextver; err = nexterr; goto nextiter; }
+            }
+            if(debug) println(hlog, "cannot improve error ", err);
+            final_err = err;
+            return at;
+          }
+        break;
+        }
+      goto nextfix;
+      }
+    
+    nextiter: ;
+    }
+  
+  final_err = err;
+  return at;
+  }
+
+ptlow mlow(ld x, ld y, ld z) { return ptlow({float(x), float(y), float(z)}); }
+
+hyperpoint atxyz(ld x, ld y, ld z) { return hyperpoint({x, y, z, 1}); }
+
+ptlow operator +(ptlow a, ptlow b) { return mlow(a[0]+b[0], a[1]+b[1], a[2]+b[2]); }
+ptlow operator -(ptlow a, ptlow b) { return mlow(a[0]-b[0], a[1]-b[1], a[2]-b[2]); }
+ptlow operator *(ptlow a, ld x) { return mlow(a[0]*x, a[1]*x, a[2]*x); }
+
+ptlow can(hyperpoint x) {
+  // azimuthal equidistant to Klein
+  ld r = sqrt(x[0] * x[0] + x[1] * x[1] + x[2] * x[2]);
+  if(r == 0) return mlow(0,0,0);
+  ld make_r = tanh(r);
+  ld d = make_r / r;
+  return mlow(x[0]*d, x[1]*d, x[2]*d);
+  }
+
+hyperpoint uncan(ptlow x) {
+  ld r = sqrt(x[0] * x[0] + x[1] * x[1] + x[2] * x[2]);
+  if(r == 0) return atxyz(0,0,0);
+  ld make_r = atanh(r);
+  if(r == 1) make_r = 30;
+  ld d = make_r / r;
+  return atxyz(x[0]*d, x[1]*d, x[2]*d);
+  }
+
+hyperpoint uncan_info(ptlow x) {
+  ld r = sqrt(x[0] * x[0] + x[1] * x[1] + x[2] * x[2]);
+  println(hlog, "r = ", r);
+  if(r == 0) return atxyz(0,0,0);
+  ld make_r = atanh(r);
+  println(hlog, "make_r = ", make_r);
+  ld d = make_r / r;
+  println(hlog, "d = ", d);
+  return atxyz(x[0]*d, x[1]*d, x[2]*d);
+  }
+
+void write_table(solnihv::tabled_inverses& tab, const char *fname) {
+  tab.save(fname, solnihv::save_encoding, solnihv::save_compressed);
+  }
+
+void alloc_table(solnihv::tabled_inverses& tab, int X, int Y, int Z) {
+  tab.PRECX = X;
+  tab.PRECY = Y;
+  tab.PRECZ = Z;
+  tab.tab.resize(X*Y*Z);
+  tab.blocks[0] = tab.blocks[1] = tab.blocks[2] = 0;
+  }
+
+ld ix_to_x(ld ix) {
+  ld minx = 0, maxx = 1;
+  for(int it=0; it<100; it++) {
+    ld x = (minx + maxx) / 2;
+    if(x_to_ix(atanh(x)) < ix) minx = x;
+    else maxx = x;
+    }
+  return atanh(minx);
+  }
+
+ld iz_to_z(ld z) {
+  return nih ? atanh(z * 2 - 1)*4 : atanh(z); // atanh(z * 2 - 1);
+  }
+
+ld ptd(ptlow p) {
+  return p[0]*p[0] + p[1]*p[1] + p[2] * p[2];
+  }
+
+ptlow zflip(ptlow x) { return mlow(x[1], x[0], -x[2]); }
+
+/** statistics of one slab (z-coordinate) of the table */
+struct slab_stats {
+  std::atomic<int> rows_left;
+  std::mutex lock;
+  int solves = 0, iterations = 0, max_iterations = 0, seeded = 0, failures = 0;
+  ld max_err = 0;
+  ld ms = 0;
+  };
+
+int table_threads = std::thread::hardware_concurrency();
+
+/** how far (relative to its length) the solution may be from the seed to be accepted without trying the other candidates */
+ld seed_jump = 0.2;
+
+/** a solve from the seed which takes more iterations is abandoned */
+int seed_iterations = 100;
+
+/** where build_sols saves its progress, and how often (in seconds) */
+string checkpoint_file;
+int checkpoint_interval = 60;
+
+static const int checkpoint_version = 1;
+
+/** the number of steps of numerical_exp */
+static constexpr int solve_prec = 100;
+
+/** solve for v, starting from each of the candidates in turn (the last one should be the origin); the error is returned in xerr */
+hyperpoint solve_point(hyperpoint v, const vector<hyperpoint>& candidates, slab_stats& st, ld& xerr) {
+  hyperpoint cand;
+  xerr = 1e9;
+  /* A solution close to its seed continues the geodesic of the neighbor. Otherwise, it may have jumped
+   * to another geodesic (there are several beyond the cut locus), so the remaining candidates are also
+   * tried, and the shortest geodesic found is used.
+   */
+  bool from_seed = false;
+  for(int ci=0; ci<isize(candidates); ci++) {
+    int iterations = 0;
+    ld err;
+    bool last = ci == isize(candidates)-1;
+    auto solt = iterative_solve(v, candidates[ci], solve_prec, 1e-6, last ? INT_MAX : seed_iterations, iterations, err);
+    st.iterations += iterations;
+    st.max_iterations = max(st.max_iterations, iterations);
+    bool better = err <= 1e-6 ? (xerr > 1e-6 || hypot_d(3, solt) < hypot_d(3, cand)) : err < xerr;
+    if(better) xerr = err, cand = solt, from_seed = !last;
+    if(err <= 1e-6 && hypot_d(3, solt - candidates[ci]) < seed_jump * (1 + hypot_d(3, candidates[ci]))) break;
+    }
+  if(from_seed) st.seeded++;
+  
+  st.solves++;
+  st.max_err = max(st.max_err, xerr);
+  return cand;
+  }
+
+/** the checkpoint contains the sizes, the rows which have been solved, and the whole table */
+void save_checkpoint(solnihv::tabled_inverses& tab, const vector<std::atomic<char>>& done) {
+  int rows = tab.PRECY * tab.PRECZ;
+  vector<char> d(rows);
+  vector<ptlow> data(tab.PRECX * rows, mlow(0, 0, 0));
+  for(int r=0; r<rows; r++) {
+    d[r] = done[r].load(std::memory_order_acquire);
+    if(d[r]) for(int x=0; x<tab.PRECX; x++) data[r * tab.PRECX + x] = tab.tab[r * tab.PRECX + x];
+    }
+  string tmp = checkpoint_file + ".tmp";
+  FILE *f = fopen(tmp.c_str(), "wb");
+  if(!f) { println(hlog, "cannot write ", tmp); return; }
+  int header[6] = {checkpoint_version, int(geometry), tab.PRECX, tab.PRECY, tab.PRECZ, rows};
+  bool ok = fwrite(header, sizeof(header), 1, f) == 1;
+  ok = ok && fwrite(&d[0], rows, 1, f) == 1;
+  ok = ok && fwrite(&data[0], sizeof(ptlow) * data.size(), 1, f) == 1;
+  ok = fclose(f) == 0 && ok;
+  if(ok) ok = rename(tmp.c_str(), checkpoint_file.c_str()) == 0;
+  if(!ok) println(hlog, "checkpoint could not be saved");
+  }
+
+/** restore the progress from the checkpoint, if it exists and matches the table; returns the number of solved rows */
+int load_checkpoint(solnihv::tabled_inverses& tab, vector<std::atomic<char>>& done) {
+  FILE *f = fopen(checkpoint_file.c_str(), "rb");
+  if(!f) return 0;
+  int rows = tab.PRECY * tab.PRECZ;
+  int header[6];
+  vector<char> d(rows);
+  int res = 0;
+  if(fread(header, sizeof(header), 1, f) == 1 && header[0] == checkpoint_version && header[1] == int(geometry)
+    && header[2] == tab.PRECX && header[3] == tab.PRECY && header[4] == tab.PRECZ && header[5] == rows
+    && fread(&d[0], rows, 1, f) == 1 && fread(&tab.tab[0], sizeof(ptlow) * tab.PRECX * rows, 1, f) == 1) {
+    for(int r=0; r<rows; r++) if(d[r]) done[r] = true, res++;
+    }
+  else println(hlog, "checkpoint ", checkpoint_file, " does not match, ignored");
+  fclose(f);
+  return res;
+  }
+
+/** solve the table for the current geometry.
+ *  Each row (fixed iy and iz) is a task; idle threads take the next unsolved row, so the load is balanced
+ *  even though the rows differ a lot in cost. Each solve starts from the solution of the previous entry in the row.
+ */
+void build_sols(int PRECX, int PRECY, int PRECZ) {
+  std::mutex file_mutex;
+  auto& tab = solnihv::get_tabled();
+  alloc_table(tab, PRECX, PRECY, PRECZ);
+  int last_x = PRECX-1, last_y = PRECY-1, last_z = PRECZ-1;
+  
+  int rows = PRECY * PRECZ;
+  vector<std::atomic<char>> done(rows);
+  for(auto& d: done) d = false;
+  vector<slab_stats> stats(PRECZ);
+  
+  /* the rows to solve; the rows at the ends are extrapolated afterwards */
+  vector<int> tasks;
+  for(int iz=0; iz<PRECZ; iz++) {
+    stats[iz].rows_left = 0;
+    if((nih && iz == 0) || iz == PRECZ-1) continue;
+    for(int iy=0; iy<last_y; iy++) tasks.push_back(iz * PRECY + iy);
+    }
+  
+  int resumed = checkpoint_file == "" ? 0 : load_checkpoint(tab, done);
+  if(resumed) println(hlog, "resuming: ", resumed, " rows already solved");
+  for(int t: tasks) if(!done[t]) stats[t / PRECY].rows_left++;
+  
+  std::atomic<int> next_task(0);
+  std::atomic<int> running(table_threads);
+  
+  auto solve_row = [&] (int iz, int iy) {
+    auto t0 = profile_clock();
+    slab_stats st;
+    
+    for(int ix=0; ix<last_x; ix++) {
+      ld x = ix_to_x(ix / (PRECX-1.));
+      ld y = ix_to_x(iy / (PRECY-1.));
+      ld z = iz_to_z(iz / (PRECZ-1.));
+      
+      auto v = hyperpoint ({x,y,z,1});
+      
+      /* only the previous entry in the row is used as the seed, so that the result does not depend on the order of the rows */
+      vector<hyperpoint> candidates;
+      if(ix > 0) candidates.push_back(uncan(tab.at(ix-1, iy, iz)));
+      candidates.push_back(atxyz(0,0,0));
+      
+      ld xerr;
+      hyperpoint cand = solve_point(v, candidates, st, xerr);
+      
+      if(xerr > 1e-3) {
+        st.failures++;
+        std::lock_guard<std::mutex> fm(file_mutex);
+        println(hlog, format("[%2d %2d %2d] ", iz, iy, ix));
+        println(hlog, "f(?) = ", v);
+        println(hlog, "f(", cand, ") = ", nisot::numerical_exp(cand, solve_prec));
+        println(hlog, "error = ", xerr);
+        println(hlog, "canned = ", can(cand));
+        continue;
+        }
+
+      auto& so = tab.at(ix, iy, iz);
+
+      so = can(cand);
+      
+      for(int z=0; z<3; z++) if(isnan(so[z]) || isinf(so[z])) {
+        println(hlog, cand, "canned to ", so);
+        exit(4);
+        }
+      }
+    
+    done[iz * PRECY + iy].store(true, std::memory_order_release);
+    
+    auto& s = stats[iz];
+    std::lock_guard<std::mutex> sl(s.lock);
+    s.solves += st.solves; s.iterations += st.iterations; s.seeded += st.seeded; s.failures += st.failures;
+    s.max_iterations = max(s.max_iterations, st.max_iterations);
+    s.max_err = max(s.max_err, st.max_err);
+    s.ms += (profile_clock() - t0) / 1e6;
+    if(--s.rows_left == 0) {
+      std::lock_guard<std::mutex> fm(file_mutex);
+      println(hlog, format("slab %3d: %6d solves, %5.2f iterations (max %3d), %5.1f%% from neighbors, max error %.2g, %d failed, %.0f ms",
+        iz, s.solves, s.iterations * 1. / max(s.solves, 1), s.max_iterations, s.seeded * 100. / max(s.solves, 1), double(s.max_err), s.failures, double(s.ms)));
+      }
+    };
+  
+  std::vector<std::thread> threads;
+  for(int k=0; k<table_threads; k++)
+    threads.emplace_back([&] () {
+      while(true) {
+        int i = next_task++;
+        if(i >= isize(tasks)) break;
+        int t = tasks[i];
+        if(done[t]) continue;
+        solve_row(t / PRECY, t % PRECY);
+        }
+      running--;
+      });
+  
+  if(checkpoint_file != "") {
+    auto last = time(NULL);
+    while(running > 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      if(time(NULL) >= last + checkpoint_interval) {
+        save_checkpoint(tab, done);
+        last = time(NULL);
+        }
+      }
+    }
+  for(std::thread& t: threads) t.join();
+  
+  for(int x=0; x<last_x; x++)
+  for(int y=0; y<last_y; y++) {
+    for(int z=last_z; z<PRECZ; z++)
+      tab.at(x,y,z) = tab.at(x,y,z-1) * 2 - tab.at(x,y,z-2);
+    if(nih)
+      tab.at(x,y,0) = tab.at(x,y,1) * 2 - tab.at(x,y,2);
+    }
+  
+  for(int x=0; x<last_x; x++)
+  for(int y=last_y; y<PRECY; y++)
+  for(int z=0; z<PRECZ; z++)
+    tab.at(x,y,z) = tab.at(x,y-1,z) * 2 - tab.at(x,y-2,z);
+  
+  for(int x=last_x; x<PRECX; x++)
+  for(int y=0; y<PRECY; y++)
+  for(int z=0; z<PRECZ; z++)
+    tab.at(x,y,z) = tab.at(x-1,y,z) * 2 - tab.at(x-2,y,z);
+
+  tab.use_tab();
+  }
+
+/* Adaptive tables. The unit cube of the table coordinates is divided into adaptive_blocks^3 blocks, each of them
+ * a uniform grid of (2^l+1)^3 entries, where l is the level of the block. All the blocks start at initial_level,
+ * computed by build_sols as one uniform table. Then a block is refined (its level is increased) while the
+ * interpolation at the centers of its cells differs from the solutions there by more than adaptive_tolerance,
+ * up to max_level.
+ */
+
+int adaptive_blocks = 16, initial_level = 1, max_level = 3;
+ld adaptive_tolerance = 1e-3;
+
+struct adaptive_block {
+  int level;
+  vector<ptlow> v;
+  int side() { return (1 << level) + 1; }
+  ptlow& at(int x, int y, int z) { int s = side(); return v[(z*s+y)*s+x]; }
+  /** x, y, z are in the units of the cells of this block */
+  ptlow interpolate(ld x, ld y, ld z) {
+    int c = 1 << level;
+    ld p[3] = {x, y, z};
+    int a[3];
+    for(int d=0; d<3; d++) { a[d] = min(max(int(p[d]), 0), c-1); p[d] -= a[d]; }
+    ptlow res = mlow(0, 0, 0);
+    for(int k=0; k<8; k++) {
+      ld w = 1;
+      for(int d=0; d<3; d++) w *= ((k>>d)&1) ? p[d] : 1-p[d];
+      res = res + at(a[0] + (k&1), a[1] + ((k>>1)&1), a[2] + ((k>>2)&1)) * w;
+      }
+    return res;
+    }
+  };
+
+ld lowdist(ptlow a, ptlow b) { return sqrt(ptd(a - b)); }
+
+/** the entry of the table at the given table coordinates, solved from the prediction (or the origin); false if not solved */
+bool solve_entry(ld ix, ld iy, ld iz, ptlow pred, slab_stats& st, ptlow& res) {
+  vector<hyperpoint> candidates;
+  if(ptd(pred) < 1) candidates.push_back(uncan(pred));
+  candidates.push_back(atxyz(0,0,0));
+  ld xerr;
+  hyperpoint cand = solve_point(atxyz(ix_to_x(ix), ix_to_x(iy), iz_to_z(iz)), candidates, st, xerr);
+  if(xerr > 1e-3) { st.failures++; return false; }
+  res = can(cand);
+  return true;
+  }
+
+/** the entries at the upper edges (and the lower edge in z, for nih) are extrapolated, in the same order as in build_sols */
+void extrapolate_block(adaptive_block& b, int bx, int by, int bz) {
+  int B = adaptive_blocks, c = 1 << b.level;
+  bool ex = bx == B-1, ey = by == B-1, ez = bz == B-1, ez0 = nih && bz == 0;
+  for(int x=0; x<=c; x++) for(int y=0; y<=c; y++) {
+    if((ex && x == c) || (ey && y == c)) continue;
+    if(ez) b.at(x,y,c) = b.at(x,y,c-1) * 2 - b.at(x,y,c-2);
+    if(ez0) b.at(x,y,0) = b.at(x,y,1) * 2 - b.at(x,y,2);
+    }
+  if(ey) for(int x=0; x<=c; x++) for(int z=0; z<=c; z++) {
+    if(ex && x == c) continue;
+    b.at(x,c,z) = b.at(x,c-1,z) * 2 - b.at(x,c-2,z);
+    }
+  if(ex) for(int y=0; y<=c; y++) for(int z=0; z<=c; z++)
+    b.at(c,y,z) = b.at(c-1,y,z) * 2 - b.at(c-2,y,z);
+  }
+
+/** refine the block while needed; the solutions at the centers of the cells of one level become the entries of the next one */
+void refine_block(adaptive_block& b, int bx, int by, int bz, slab_stats& st) {
+  int B = adaptive_blocks;
+  while(b.level < max_level) {
+    int c = 1 << b.level;
+    adaptive_block nb;
+    nb.level = b.level + 1;
+    nb.v.resize(nb.side() * nb.side() * nb.side());
+    auto coord = [&] (int block, int x) { return (block + x / (2. * c)) / B; };
+    auto solve_at = [&] (int x, int y, int z) {
+      ptlow pred = b.interpolate(x / 2., y / 2., z / 2.);
+      nb.at(x, y, z) = pred;
+      solve_entry(coord(bx, x), coord(by, y), coord(bz, z), pred, st, nb.at(x, y, z));
+      return lowdist(pred, nb.at(x, y, z));
+      };
+    ld err = 0;
+    for(int x=0; x<c; x++) for(int y=0; y<c; y++) for(int z=0; z<c; z++)
+      err = max(err, solve_at(2*x+1, 2*y+1, 2*z+1));
+    if(err <= adaptive_tolerance) return;
+    
+    int B1 = B-1, c2 = 2*c;
+    for(int x=0; x<=c2; x++) for(int y=0; y<=c2; y++) for(int z=0; z<=c2; z++) {
+      if(x%2 == 0 && y%2 == 0 && z%2 == 0) nb.at(x, y, z) = b.at(x/2, y/2, z/2);
+      else if(x%2 && y%2 && z%2) continue;
+      else if((bx == B1 && x == c2) || (by == B1 && y == c2) || (bz == B1 && z == c2) || (nih && bz == 0 && z == 0)) continue;
+      else solve_at(x, y, z);
+      }
+    extrapolate_block(nb, bx, by, bz);
+    b = std::move(nb);
+    }
+  }
+
+/** build the adaptive table for the current geometry; PRECX, PRECY, PRECZ are the size of the uniform grid resampled for the GPU */
+void build_adaptive(int PRECX, int PRECY, int PRECZ) {
+  int B = adaptive_blocks;
+  int c0 = 1 << initial_level, N0 = B * c0 + 1;
+  auto t0 = profile_clock();
+  build_sols(N0, N0, N0);
+  auto& tab = solnihv::get_tabled();
+  
+  vector<adaptive_block> blocks(B*B*B);
+  auto id_of = [&] (int bx, int by, int bz) { return (bz*B+by)*B+bx; };
+  for(int bz=0; bz<B; bz++) for(int by=0; by<B; by++) for(int bx=0; bx<B; bx++) {
+    auto& b = blocks[id_of(bx, by, bz)];
+    b.level = initial_level;
+    b.v.resize(b.side() * b.side() * b.side());
+    for(int z=0; z<=c0; z++) for(int y=0; y<=c0; y++) for(int x=0; x<=c0; x++)
+      b.at(x, y, z) = tab.at(bx*c0+x, by*c0+y, bz*c0+z);
+    }
+  
+  vector<slab_stats> stats(B);
+  for(auto& s: stats) s.rows_left = B*B;
+  std::atomic<int> next_block(0);
+  std::mutex print_mutex;
+  
+  std::vector<std::thread> threads;
+  for(int k=0; k<table_threads; k++)
+    threads.emplace_back([&] () {
+      while(true) {
+        int i = next_block++;
+        if(i >= B*B*B) break;
+        int bz = i / B / B;
+        auto t1 = profile_clock();
+        slab_stats st;
+        refine_block(blocks[i], i % B, i / B % B, bz, st);
+        auto& s = stats[bz];
+        std::lock_guard<std::mutex> sl(s.lock);
+        s.solves += st.solves; s.iterations += st.iterations; s.failures += st.failures;
+        s.ms += (profile_clock() - t1) / 1e6;
+        if(--s.rows_left == 0) {
+          int levels[16] = {};
+          for(int j=0; j<B*B; j++) levels[blocks[bz*B*B+j].level]++;
+          shstream ss;
+          for(int l=initial_level; l<=max_level; l++) print(ss, " ", levels[l]);
+          std::lock_guard<std::mutex> pm(print_mutex);
+          println(hlog, format("block slab %3d: blocks per level%s, %6d solves, %5.2f iterations, %d failed, %.0f ms",
+            bz, ss.s.c_str(), s.solves, s.iterations * 1. / max(s.solves, 1), s.failures, double(s.ms)));
+          }
+        }
+      });
+  for(std::thread& t: threads) t.join();
+  
+  /* A face (or edge) shared by blocks of different levels would have a crack, so the entries on it are
+   * interpolated from the coarsest of these blocks. The blocks are fixed from the coarsest ones, so that
+   * the source is always final.
+   */
+  int M = 1 << max_level;
+  vector<int> order(B*B*B);
+  for(int i=0; i<B*B*B; i++) order[i] = i;
+  auto rank = [&] (int i) { return make_pair(blocks[i].level, i); };
+  sort(order.begin(), order.end(), [&] (int i, int j) { return rank(i) < rank(j); });
+  for(int i: order) {
+    auto& b = blocks[i];
+    int c = 1 << b.level, f = M / c;
+    int bc[3] = {i % B, i / B % B, i / B / B};
+    for(int z=0; z<=c; z++) for(int y=0; y<=c; y++) for(int x=0; x<=c; x++) {
+      int lc[3] = {x, y, z};
+      if(x%c && y%c && z%c) continue;
+      /* the position in the units of the finest level, and the candidate blocks in each direction */
+      int pos[3];
+      vector<int> cands[3];
+      for(int d=0; d<3; d++) {
+        pos[d] = (bc[d] * c + lc[d]) * f;
+        int k = pos[d] / M;
+        if(k < B) cands[d].push_back(k);
+        if(pos[d] % M == 0 && k > 0) cands[d].push_back(k-1);
+        }
+      int best = i;
+      for(int kx: cands[0]) for(int ky: cands[1]) for(int kz: cands[2]) {
+        int j = id_of(kx, ky, kz);
+        if(rank(j) < rank(best)) best = j;
+        }
+      if(best == i) continue;
+      auto& s = blocks[best];
+      int sc[3] = {best % B, best / B % B, best / B / B};
+      int sf = M >> s.level;
+      b.at(x, y, z) = s.interpolate((pos[0] - sc[0]*M) * 1. / sf, (pos[1] - sc[1]*M) * 1. / sf, (pos[2] - sc[2]*M) * 1. / sf);
+      }
+    }
+  
+  tab.PRECX = PRECX; tab.PRECY = PRECY; tab.PRECZ = PRECZ;
+  tab.tab.clear();
+  tab.block_tab.clear();
+  int levels[16] = {};
+  for(auto& b: blocks) {
+    tab.block_tab.push_back((isize(tab.tab) << 4) | b.level);
+    for(auto& e: b.v) tab.tab.push_back(e);
+    levels[b.level]++;
+    }
+  for(int d=0; d<3; d++) tab.blocks[d] = B;
+  tab.use_tab();
+  
+  int es = solnihv::save_encoding == solnihv::teHalf ? 6 : 12;
+  ld uniform = pow(B * M + 1., 3) * es;
+  ld bytes = isize(tab.tab) * es + 4. * isize(blocks);
+  shstream ss;
+  for(int l=initial_level; l<=max_level; l++) print(ss, " ", levels[l]);
+  println(hlog, format("adaptive table: %d^3 blocks, blocks per level%s, %d entries, %.0f KB (a uniform %d^3 table: %.0f KB, %.1f%%), %.1f s",
+    B, ss.s.c_str(), isize(tab.tab), bytes / 1024, B * M + 1, uniform / 1024, bytes * 100 / uniform, (profile_clock() - t0) / 1e9));
+  }
+
+/** compare the table from the file with the solutions at random points in the range which is used (solrange_xy, solrange_z),
+ *  and measure the speed of get and get_batch. If uniform > 0, also compute the error of a uniform table of that size at the
+ *  same points (only the corners of the cells with the points are solved).
+ */
+void table_bench(string fname, int samples, int uniform) {
+  solnihv::tabled_inverses t(fname);
+  t.load();
+  if(!t.loaded) { println(hlog, "cannot load ", fname); return; }
+  bool sym = !nih;
+  auto z_to_iz = [&] (ld z) { return sym ? tanh(z) : (tanh(z/4)+1)/2; };
+  ld maxix = x_to_ix(solnihv::solrange_xy);
+  ld miniz = z_to_iz(sym ? 0 : -solnihv::solrange_z), maxiz = z_to_iz(solnihv::solrange_z);
+  
+  std::mt19937 gen(1);
+  auto rnd = [&] (ld a, ld b) { return a + (b - a) * (gen() % 1000000) / 1e6; };
+  vector<hyperpoint> pts(samples);
+  for(auto& p: pts) p = point3(rnd(0, maxix), rnd(0, maxix), rnd(miniz, maxiz));
+  
+  auto low = [] (hyperpoint h) { return mlow(h[0], h[1], h[2]); };
+  slab_stats st;
+  vector<ptlow> exact(samples);
+  vector<char> ok(samples);
+  for(int i=0; i<samples; i++) ok[i] = solve_entry(pts[i][0], pts[i][1], pts[i][2], low(t.get(pts[i][0], pts[i][1], pts[i][2], false)), st, exact[i]);
+  
+  /* the maximum is given separately, since the inverse exponential is not continuous beyond the cut locus */
+  auto report = [&] (string name, ld bytes, const std::function<ptlow(hyperpoint)>& f) {
+    vector<ld> errs;
+    ld sumerr = 0;
+    for(int i=0; i<samples; i++) if(ok[i]) {
+      errs.push_back(lowdist(f(pts[i]), exact[i]));
+      sumerr += errs.back();
+      }
+    if(errs.empty()) return;
+    sort(errs.begin(), errs.end());
+    auto pct = [&] (ld p) { return double(errs[min(int(p * isize(errs)), isize(errs)-1)]); };
+    println(hlog, format("%-24s %10.0f KB  error: max %.3g, 99.9%% %.3g, 99%% %.3g, 90%% %.3g, mean %.3g",
+      name.c_str(), double(bytes / 1024), double(errs.back()), pct(.999), pct(.99), pct(.9), double(sumerr / isize(errs))));
+    };
+  
+  int es = t.encoding == solnihv::teHalf ? 6 : 12;
+  ld bytes = t.entry_count() * es + (t.blocks[0] ? 4. * t.blocks[0] * t.blocks[1] * t.blocks[2] : 0);
+  println(hlog, samples, " samples, ", st.failures, " not solved, ", st.solves, " solves");
+  report(fname, bytes, [&] (hyperpoint p) { return low(t.get(p[0], p[1], p[2], false)); });
+  
+  if(uniform > 0) {
+    int P = uniform;
+    /* the entries of the uniform table, solved or extrapolated as in build_sols */
+    map<array<int, 3>, ptlow> known;
+    std::function<ptlow(int, int, int)> value = [&] (int x, int y, int z) {
+      if(x == P-1) return value(P-2, y, z) * 2 - value(P-3, y, z);
+      if(y == P-1) return value(x, P-2, z) * 2 - value(x, P-3, z);
+      if(z == P-1) return value(x, y, P-2) * 2 - value(x, y, P-3);
+      if(nih && z == 0) return value(x, y, 1) * 2 - value(x, y, 2);
+      array<int, 3> key = {x, y, z};
+      if(known.count(key)) return known[key];
+      ld ix = x / (P-1.), iy = y / (P-1.), iz = z / (P-1.);
+      ptlow res = low(t.get(ix, iy, iz, false));
+      solve_entry(ix, iy, iz, res, st, res);
+      return known[key] = res;
+      };
+    auto f = [&] (hyperpoint p) {
+      ld c[3];
+      int a[3];
+      for(int d=0; d<3; d++) { c[d] = p[d] * (P-1); a[d] = min(int(c[d]), P-2); c[d] -= a[d]; }
+      ptlow res = mlow(0, 0, 0);
+      for(int k=0; k<8; k++) {
+        ld w = 1;
+        for(int d=0; d<3; d++) w *= ((k>>d)&1) ? c[d] : 1-c[d];
+        res = res + value(a[0] + (k&1), a[1] + ((k>>1)&1), a[2] + ((k>>2)&1)) * w;
+        }
+      return res;
+      };
+    report("uniform " + its(P) + "^3", pow(P, 3) * es, f);
+    }
+  
+  int N = 1000000;
+  vector<hyperpoint> in(N), out(N);
+  for(auto& p: in) p = point3(rnd(0, 1), rnd(0, 1), rnd(0, 1));
+  /* the first pass reads the mapped file */
+  t.get_batch(&in[0], &out[0], N, false);
+  auto t1 = profile_clock();
+  ld s = 0;
+  for(int i=0; i<N; i++) s += t.get(in[i][0], in[i][1], in[i][2], false)[0];
+  auto t2 = profile_clock();
+  t.get_batch(&in[0], &out[0], N, false);
+  auto t3 = profile_clock();
+  println(hlog, format("lookup: get %.1f Mpts/s, get_batch %.1f Mpts/s (%g)", N * 1e3 / (t2 - t1), N * 1e3 / (t3 - t2), double(s)));
+  
+  if(uniform > 0) {
+    /* the speed of a uniform table of the same size and encoding, resampled from t */
+    int P = uniform;
+    solnihv::tabled_inverses u("");
+    u.PRECX = u.PRECY = u.PRECZ = P;
+    vector<unsigned short> halfs;
+    for(int z=0; z<P; z++) for(int y=0; y<P; y++) for(int x=0; x<P; x++) {
+      auto h = t.get(x / (P-1.), y / (P-1.), z / (P-1.), false);
+      u.tab.push_back(low(h));
+      for(int c=0; c<3; c++) halfs.push_back(solnihv::float_to_half(h[c]));
+      }
+    u.use_tab();
+    if(t.encoding == solnihv::teHalf) u.data = &halfs[0], u.encoding = solnihv::teHalf;
+    u.get_batch(&in[0], &out[0], N, false);
+    auto t4 = profile_clock();
+    for(int i=0; i<N; i++) s += u.get(in[i][0], in[i][1], in[i][2], false)[0];
+    auto t5 = profile_clock();
+    u.get_batch(&in[0], &out[0], N, false);
+    auto t6 = profile_clock();
+    println(hlog, format("uniform %d^3: get %.1f Mpts/s, get_batch %.1f Mpts/s (%g)", P, N * 1e3 / (t5 - t4), N * 1e3 / (t6 - t5), double(s)));
+    }
+  }
+
+int dimX = 64, dimY = 64, dimZ = 64;
+
+int readArgs() {
+  using namespace arg;
+           
+  if(0) ;
+  else if(argis("-dim")) {
+    PHASEFROM(2); 
+    shift(); dimX = argi();
+    shift(); dimY = argi();
+    shift(); dimZ = argi();
+    }
+  else if(argis("-build")) {
+    PHASEFROM(2); 
+    build_sols(dimX, dimY, dimZ);
+    }
+  else if(argis("-write")) {
+    PHASEFROM(2); 
+    shift();
+    dynamicval<string> cf(checkpoint_file, checkpoint_file == "" ? args() + ".ckpt" : checkpoint_file);
+    build_sols(dimX, dimY, dimZ);
+    write_table(solnihv::get_tabled(), argcs());
+    unlink(checkpoint_file.c_str());
+    }
+  else if(argis("-adaptive")) {
+    shift(); adaptive_blocks = argi();
+    shift(); initial_level = argi();
+    shift(); max_level = argi();
+    shift_arg_formula(adaptive_tolerance);
+    }
+  else if(argis("-build-adaptive")) {
+    PHASEFROM(2); 
+    build_adaptive(dimX, dimY, dimZ);
+    }
+  else if(argis("-write-adaptive")) {
+    PHASEFROM(2); 
+    shift();
+    dynamicval<string> cf(checkpoint_file, checkpoint_file == "" ? args() + ".ckpt" : checkpoint_file);
+    build_adaptive(dimX, dimY, dimZ);
+    write_table(solnihv::get_tabled(), argcs());
+    unlink(checkpoint_file.c_str());
+    }
+  else if(argis("-table-bench")) {
+    PHASEFROM(2);
+    shift(); string fname = args();
+    shift(); int samples = argi();
+    shift(); table_bench(fname, samples, argi());
+    }
+  else if(argis("-table-seed-jump")) {
+    shift_arg_formula(seed_jump);
+    }
+  else if(argis("-table-threads")) {
+    shift(); table_threads = max(argi(), 1);
+    }
+  else if(argis("-table-checkpoint")) {
+    shift(); checkpoint_file = args();
+    shift(); checkpoint_interval = argi();
+    }
+
+  else return 1;
+  return 0;
+  }
+
+auto hook = addHook(hooks_args, 100, readArgs);
+
+}
+}
@@ -34,6 +34,7 @@ static const int POLY_ALWAYS_IN = (1<<21);      // always draw this
 static const int POLY_TRIANGLES = (1<<22);      // made of TRIANGLES, not TRIANGLE_FAN
 static const int POLY_INTENSE = (1<<23);        // extra intense colors
 static const int POLY_DEBUG = (1<<24);          // debug this shape
+static const int POLY_LAZY = (1<<25);           // a 3D model which is built when first drawn, see require_model
 
 struct drawqueueitem {
   PPR prio;
@@ -91,7 +92,7 @@ struct dqi_circle : drawqueueitem {
 struct dqi_action : drawqueueitem {
   reaction_t action;
   dqi_action(const reaction_t& a) : action(a) {}
-  void draw() { action(); }
+  void draw();
   virtual color_t outline_group() { return 2; }
   };
 #endif
@@ -122,6 +123,9 @@ EX GLuint text_texture;
 EX int texts_merged;
 EX int shapes_merged;
 
+/** statistics of the last frame: the glDrawArrays calls for polygons, and the instanced draws with the number of polygons they have drawn */
+EX int poly_draw_calls, instanced_draws, instanced_polys;
+
 #if MINIMIZE_GL_CALLS
 color_t triangle_color, line_color;
 vector<glvertex> triangle_vertices;
@@ -129,6 +133,10 @@ vector<glvertex> line_vertices;
 #endif
 
 EX void glflush() {
+  #if CAP_SDL
+  swrender::flush();
+  #endif
+
   #if MINIMIZE_GL_CALLS
   if(isize(triangle_vertices)) {
     // printf("%08X %08X | %d shapes, %d/%d vertices\n", triangle_color, line_color, shapes_merged, isize(triangle_vertices), isize(line_vertices));
@@ -285,6 +293,19 @@ void fixpoint(glvertex& hscr, hyperpoint H) {
   hscr = glhr::makevertex(Hscr[0]*current_display->radius, Hscr[1]*current_display->radius*vid.stretch, Hscr[2]*current_display->radius); 
   }
 
+void add_projected(hyperpoint Hscr, ld z) {
+  if(GDIM == 2) {
+    for(int i=0; i<3; i++) Hscr[i] *= z;
+    Hscr[1] *= vid.stretch;
+    }
+  else {
+    Hscr[0] *= z;
+    Hscr[1] *= z * vid.stretch;
+    Hscr[2] = 1 - 2 * (-Hscr[2] - models::clip_min) / (models::clip_max - models::clip_min);
+    }
+  add1(Hscr);
+  }
+
 void addpoint(const hyperpoint& H) {
   if(true) {
     ld z = current_display->radius;
@@ -331,16 +352,7 @@ void addpoint(const hyperpoint& H) {
         }
       Hlast = Hscr;
       }
-    if(GDIM == 2) {
-      for(int i=0; i<3; i++) Hscr[i] *= z;
-      Hscr[1] *= vid.stretch;
-      }
-    else {
-      Hscr[0] *= z;
-      Hscr[1] *= z * vid.stretch;
-      Hscr[2] = 1 - 2 * (-Hscr[2] - models::clip_min) / (models::clip_max - models::clip_min);
-      }
-    add1(Hscr);
+    add_projected(Hscr, z);
     }
   }
 
@@ -365,6 +377,21 @@ void addpoly(const transmatrix& V, const vector<glvertex> &tab, int ofs, int cnt
       }
     return;
     }
+  if(!spherespecial && !(sphere && pmodel == mdSpiral)) {
+    /* the usual case: when no point is behind the camera, project the whole polygon in one batch */
+    static vector<hyperpoint> batch;
+    batch.resize(cnt);
+    bool behind = false;
+    for(int i=0; i<cnt; i++) {
+      batch[i] = V * glhr::gltopoint(tab[ofs+i]);
+      if(is_behind(batch[i])) { behind = true; break; }
+      }
+    if(!behind) {
+      applymodel_batch(batch.data(), batch.data(), cnt);
+      for(auto& h: batch) add_projected(h, current_display->radius);
+      return;
+      }
+    }
   tofix.clear(); knowgood = false;
   hyperpoint last = V * glhr::gltopoint(tab[ofs]);
   bool last_behind = is_behind(last);
@@ -547,6 +574,7 @@ void dqi_poly::gldraw() {
         glhr::set_depthtest(model_needs_depth() && prio < PPR::SUPERLINE);
         glhr::set_depthwrite(model_needs_depth() && prio != PPR::TRANSPARENT_SHADOW && prio != PPR::EUCLIDEAN_SKY);
         glhr::set_fogbase(prio == PPR::SKY ? 1.0 + (euclid ? 20 : 5 / sightranges[geometry]) : 1.0);
+        poly_draw_calls++;
         glDrawArrays(GL_TRIANGLES, ioffset, cnt);
         }
       else {
@@ -557,6 +585,7 @@ void dqi_poly::gldraw() {
         glStencilOp( GL_INVERT, GL_INVERT, GL_INVERT);
         glStencilFunc( GL_ALWAYS, 0x1, 0x1 );
         glhr::color2(0xFFFFFFFF);
+        poly_draw_calls++;
         glDrawArrays(tinf ? GL_TRIANGLES : GL_TRIANGLE_FAN, offset, cnt);
         
         current_display->set_mask(ed);
@@ -578,6 +607,7 @@ void dqi_poly::gldraw() {
             };
           glhr::vertices(scr);
           glhr::id_modelview();
+          poly_draw_calls++;
           glDrawArrays(tinf ? GL_TRIANGLES : GL_TRIANGLE_FAN, 0, 4);
           glhr::vertices(v);
           if(sp & SF_DIRECT) glapplymatrix(V);
@@ -585,6 +615,7 @@ void dqi_poly::gldraw() {
         else { 
           glStencilOp( GL_ZERO, GL_ZERO, GL_ZERO);
           glStencilFunc( GL_EQUAL, 1, 1);
+          poly_draw_calls++;
           glDrawArrays(tinf ? GL_TRIANGLES : GL_TRIANGLE_FAN, offset, cnt);
           }
         
@@ -597,6 +628,7 @@ void dqi_poly::gldraw() {
       glhr::set_depthtest(model_needs_depth() && prio < PPR::SUPERLINE);
       glhr::set_depthwrite(model_needs_depth() && prio != PPR::TRANSPARENT_SHADOW && prio != PPR::EUCLIDEAN_SKY);
       glhr::set_fogbase(prio == PPR::SKY ? 1.0 + (euclid ? 20 : 5 / sightranges[geometry]) : 1.0);
+      poly_draw_calls++;
       glDrawArrays(GL_LINE_STRIP, offset, cnt);
       }
     }
@@ -609,6 +641,86 @@ void dqi_poly::gldraw() {
   }
 #endif
 
+#if CAP_INSTANCING
+/** draw the polygons which share the shape, colour and flags with one instanced draw call */
+EX bool instancing = true;
+
+/** the batches of the current frame: batch_at[i] is k if ptds[i] is the first polygon of batches[k],
+ *  -2 if ptds[i] is drawn together with an earlier polygon, and -1 if it is drawn normally
+ */
+vector<vector<dqi_poly*>> batches;
+vector<int> batch_at;
+
+bool can_instance() {
+  if(!instancing || !vid.usingGL || GDIM != 3 || !glhr::instancing_supported()) return false;
+  if(current_display->stereo_active() || vid.stereo_mode == sODS || global_projection) return false;
+  if(!among(pmodel, mdPerspective, mdGeodesic) || sphere || sl2 || in_s2xe() || !model_needs_depth()) return false;
+  auto f = current_display->next_shader_flags;
+  current_display->next_shader_flags = GF_INSTANCED;
+  current_display->set_all(0);
+  current_display->next_shader_flags = f;
+  return get_shader_flags() & SF_DIRECT;
+  }
+
+/** only opaque triangles with the depth buffer on can be drawn out of order */
+bool instanceable(dqi_poly& p) {
+  return (p.flags & POLY_TRIANGLES) && !(p.flags & POLY_DEBUG) && p.color && part(p.color, 0) == 0xFF &&
+    p.prio < PPR::SUPERLINE && !among(p.prio, PPR::TRANSPARENT_SHADOW, PPR::EUCLIDEAN_SKY, PPR::SKY);
+  }
+
+void prepare_batches() {
+  batches.clear();
+  batch_at.assign(isize(ptds), -1);
+  if(!can_instance()) return;
+  map<tuple<const vector<glvertex>*, int, int, color_t, flagtype, PPR, basic_textureinfo*, int>, int> ids;
+  for(int i=0; i<isize(ptds); i++) {
+    auto p = dynamic_cast<dqi_poly*>(&*ptds[i]);
+    if(!p || !instanceable(*p)) continue;
+    auto key = make_tuple(p->tab, p->offset, p->cnt, p->color, p->flags, p->prio, p->tinf, p->tinf ? p->offset_texture : 0);
+    auto it = ids.find(key);
+    if(it == ids.end()) {
+      ids[key] = batch_at[i] = isize(batches);
+      batches.emplace_back(1, p);
+      }
+    else {
+      batches[it->second].push_back(p);
+      batch_at[i] = -2;
+      }
+    }
+  for(auto& b: batch_at) if(b >= 0 && isize(batches[b]) == 1) b = -1;
+  }
+
+void draw_batch(const vector<dqi_poly*>& batch) {
+  auto& p = *batch[0];
+  auto& v = *p.tab;
+  int ioffset = p.offset;
+  if(p.tinf) {
+    current_display->next_shader_flags = GF_TEXTURE | GF_INSTANCED;
+    glBindTexture(GL_TEXTURE_2D, p.tinf->texture_id);
+    glhr::vertices_texture(v, p.tinf->tvertices, p.offset, p.offset_texture);
+    ioffset = 0;
+    }
+  else {
+    current_display->next_shader_flags = GF_INSTANCED;
+    glhr::vertices(v);
+    }
+  current_display->set_all(0);
+  static vector<glhr::glmatrix> matrices;
+  matrices.clear();
+  for(auto q: batch) matrices.push_back(glmatrix_of(q->V));
+  glhr::instance_matrices(matrices);
+  glhr::id_modelview();
+  glhr::color2(p.color, (p.flags & POLY_INTENSE) ? 2 : 1);
+  glhr::set_depthtest(true);
+  glhr::set_depthwrite(true);
+  glhr::set_fogbase(1.0);
+  glDrawArraysInstanced(GL_TRIANGLES, ioffset, p.cnt, isize(batch));
+  instanced_draws++;
+  instanced_polys += isize(batch);
+  current_display->next_shader_flags = 0;
+  }
+#endif
+
 EX ld scale_at(const transmatrix& T) {
   if(GDIM == 3 && pmodel == mdPerspective) return 1 / abs((tC0(T))[2]);
   if(sol) return 1;
@@ -1554,6 +1666,16 @@ void dqi_poly::draw() {
       continue;
       }
   #endif
+
+  #if CAP_SDL
+    if(swrender::active()) {
+      if(!tinf) {
+        swrender::add_polygon(glcoords, color, outline, get_width(this), poly_flags & POLY_INVERSE, vid.xres >= 2000 || fatborder);
+        continue;
+        }
+      swrender::flush();
+      }
+  #endif
   
     coords_to_poly();
   
@@ -1671,7 +1793,17 @@ void dqi_line::draw() {
   prettyline(H1, H2, color, prf, 0, prio);
   }
 
+void dqi_action::draw() {
+  #if CAP_SDL
+  swrender::flush();
+  #endif
+  action();
+  }
+
 void dqi_string::draw() {
+  #if CAP_SDL
+  swrender::flush();
+  #endif
   #if CAP_SVG
   if(svg::in) {
     svg::text(x, y, size, str, frame, color, align);
@@ -1687,6 +1819,9 @@ void dqi_string::draw() {
   }
 
 void dqi_circle::draw() {
+  #if CAP_SDL
+  swrender::flush();
+  #endif
   #if CAP_SVG
   if(svg::in) {
     svg::circle(x, y, size, color, fillcolor, linewidth);
@@ -1716,6 +1851,9 @@ EX void quickqueue() {
   reset_projection(); current_display->set_all(0);
   int siz = isize(ptds);
   for(int i=0; i<siz; i++) ptds[i]->draw();
+  #if CAP_SDL
+  swrender::flush();
+  #endif
   ptds.clear();
   if(!keep_curvedata) {
     curvedata.clear();
@@ -1848,6 +1986,8 @@ EX void reverse_transparent_walls() {
   }
 
 EX void draw_main() {
+  profile_scope ps(prof_rasterize);
+  poly_draw_calls = instanced_draws = instanced_polys = 0;
   if(sphere && GDIM == 3 && pmodel == mdPerspective) {
     for(int p: {1, 0, 2, 3}) {
       if(elliptic && p < 2) continue;
@@ -1892,16 +2032,26 @@ EX void draw_main() {
     
     if(two_sided_model()) draw_backside();
   
-    for(auto& ptd: ptds) if(ptd->prio != PPR::OUTCIRCLE) {
+    #if CAP_INSTANCING
+    prepare_batches();
+    #endif
+    for(int i=0; i<isize(ptds); i++) if(ptds[i]->prio != PPR::OUTCIRCLE) {
+      auto& ptd = ptds[i];
+      #if CAP_INSTANCING
+      if(batch_at[i] == -2) continue;
+      if(batch_at[i] >= 0) { draw_batch(batches[batch_at[i]]); continue; }
+      #endif
       dynamicval<int> ss(spherespecial, among(ptd->prio, PPR::MOBILE_ARROW, PPR::OUTCIRCLE, PPR::CIRCLE) ? 0 : spherespecial);
       ptd->draw();
       }
     glflush();
 
     if(ray::in_use && ray::comparison_mode) {
-      glDepthFunc(GL_LEQUAL);
-      glClearDepth(1.0f);
-      glClear(GL_DEPTH_BUFFER_BIT);
+      if(vid.usingGL) {
+        glDepthFunc(GL_LEQUAL);
+        glClearDepth(1.0f);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        }
       ray::cast();
       }
     }
@@ -1922,7 +2072,7 @@ EX void drawqueue() {
     glClear(GL_STENCIL_BUFFER_BIT);
 #endif
   
-  profile_start(3);
+  profile_start(prof_sort);
   
   sort_drawqueue();
   
@@ -1942,7 +2092,7 @@ EX void drawqueue() {
         return p1->subprio > p2->subprio;
         });
 
-  profile_stop(3);
+  profile_stop(prof_sort);
 
 #if CAP_SDL
   if(current_display->stereo_active() && !vid.usingGL) {
@@ -2017,6 +2167,9 @@ template<class T, class... U> T& queuea(PPR prio, U... u) {
 
 #if CAP_SHAPES
 EX dqi_poly& queuepolyat(const transmatrix& V, const hpcshape& h, color_t col, PPR prio) {
+  #if MAXMDIM >= 4
+  if(h.flags & POLY_LAZY) cgi.require_model(h);
+  #endif
   if(prio == PPR::DEFAULT) prio = h.prio;
 
   auto& ptd = queuea<dqi_poly> (prio);
@@ -2041,7 +2194,7 @@ EX dqi_poly& queuepolyat(const transmatrix& V, const hpcshape& h, color_t col, P
     part(col,2) = part(col,3) = (part(col,2) * 2 + part(col,3) + 1)/3;
     }
   ptd.color = (darkened(col >> 8) << 8) + (col & 0xFF);
-  ptd.outline = poly_outline;
+  ptd.outline = lod::no_outlines ? OUTLINE_TRANS : poly_outline;
   ptd.linewidth = vid.linewidth;
   ptd.flags = h.flags;
   ptd.tinf = h.tinf;
@@ -2075,10 +2228,16 @@ EX dqi_poly& queuetable(const transmatrix& V, const vector<glvertex>& f, int cnt
 
 #if CAP_SHAPES
 EX dqi_poly& queuepoly(const transmatrix& V, const hpcshape& h, color_t col) {
+  #if MAXMDIM >= 4
+  if(h.flags & POLY_LAZY) cgi.require_model(h);
+  #endif
   return queuepolyat(V,h,col,h.prio);
   }
 
 void queuepolyb(const transmatrix& V, const hpcshape& h, color_t col, int b) {
+  #if MAXMDIM >= 4
+  if(h.flags & POLY_LAZY) cgi.require_model(h);
+  #endif
   queuepolyat(V,h,col,h.prio+b);
   }
 #endif
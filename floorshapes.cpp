@@ -976,16 +976,18 @@ void draw_shape_for_texture(floorshape* sh) {
     }
 
   // SL2 needs 6 times more
+  vector<hyperpoint> inmodel;
   for(int a=0; a<MAX_EDGE*6; a++)
     texture_order([&] (ld x, ld y) {
-      hyperpoint h = center + v1 * x + v2 * y;
-      hyperpoint inmodel;
-      applymodel(h, inmodel);
-      glvec2 v;
-      v[0] = (1 + inmodel[0] * vid.scale) / 2;
-      v[1] = (1 - inmodel[1] * vid.scale) / 2;
-      ftv.tvertices.push_back(glhr::makevertex(v[0], v[1], 0));
+      inmodel.push_back(center + v1 * x + v2 * y);
       });
+  applymodel_batch(inmodel.data(), inmodel.data(), isize(inmodel));
+  for(auto& h: inmodel) {
+    glvec2 v;
+    v[0] = (1 + h[0] * vid.scale) / 2;
+    v[1] = (1 - h[1] * vid.scale) / 2;
+    ftv.tvertices.push_back(glhr::makevertex(v[0], v[1], 0));
+    }
   }
 
 const int FLOORTEXTURESIZE = 4096;
@@ -0,0 +1,164 @@
+// Hyperbolic Rogue -- geometry switch benchmark
+// Copyright (C) 2011-2020 Zeno Rogue, see 'hyper.cpp' for details
+
+/** \file geom-bench.cpp
+ *  \brief measure how long switching between geometries takes, split into phases
+ *
+ *  Each switch is done the same way as in tours and `-geo` scripts (stop_game, set the geometry, start_game),
+ *  but the work normally done inside start_game and the first frame is called explicitly, so that each
+ *  part can be timed: teardown (clearing the cells), configuration, check_cgi with the basic constants,
+ *  map generation, shapes, floor textures, and the first frame.
+ */
+
+#include "hyper.h"
+namespace hr {
+
+EX namespace geom_bench {
+
+#if HDR
+/** a geometry to switch to; setup is called after the game has been stopped, and should leave the game stopped or started */
+struct switch_target {
+  string name;
+  std::function<void()> setup;
+  };
+#endif
+
+/** reset the peak resident memory, if the system allows it */
+void reset_peak_memory() {
+  #if ISLINUX
+  FILE *f = fopen("/proc/self/clear_refs", "w");
+  if(f) { fprintf(f, "5"); fclose(f); }
+  #endif
+  }
+
+/** a value in KB from /proc/self/status: VmRSS is the current resident memory, and VmHWM is the peak since the last reset_peak_memory; -1 if not known */
+int memory_kb(const char *key) {
+  #if ISLINUX
+  FILE *f = fopen("/proc/self/status", "r");
+  if(!f) return -1;
+  char buf[256];
+  int res = -1, len = strlen(key);
+  while(fgets(buf, 256, f)) if(strncmp(buf, key, len) == 0 && buf[len] == ':') res = atoi(buf + len + 1);
+  fclose(f);
+  return res;
+  #else
+  return -1;
+  #endif
+  }
+
+EX vector<switch_target> default_targets() {
+  vector<switch_target> res;
+  auto geo = [&] (string name, eGeometry g, eVariation v) {
+    res.push_back({name, [g, v] { set_geometry(g); set_variation(v); }});
+    };
+  geo("{7,3} bitruncated", gNormal, eVariation::bitruncated);
+  #if CAP_GP
+  res.push_back({"Goldberg GP(2,1)", [] { set_geometry(gNormal); gp::param = gp::loc(2, 1); set_variation(eVariation::goldberg); }});
+  #endif
+  #if CAP_IRR
+  res.push_back({"irregular", [] {
+    set_geometry(gNormal); set_variation(eVariation::pure);
+    irr::visual_creator();
+    while(irr::runlevel < 10) irr::step(1000);
+    irr::start_game_on_created_map();
+    }});
+  #endif
+  #if CAP_ARCM
+  res.push_back({"archimedean (3,4,3,4)", [] {
+    arcm::archimedean_tiling at;
+    at.parse("(3,4,3,4)");
+    set_variation(eVariation::pure); set_geometry(gArchimedean);
+    arcm::current = at;
+    }});
+  #endif
+  #if CAP_BT
+  geo("binary tiling", gBinaryTiling, eVariation::pure);
+  #endif
+  #if MAXMDIM >= 4
+  geo("{4,3,5}", gSpace435, eVariation::pure);
+  geo("Nil", gNil, eVariation::pure);
+  #if CAP_SOLV
+  geo("Sol", gSol, eVariation::pure);
+  #endif
+  #endif
+  #if CAP_CRYSTAL
+  res.push_back({"crystal {8,4}", [] { crystal::set_crystal(8); }});
+  #endif
+  return res;
+  }
+
+#if HDR
+struct switch_times {
+  ld teardown, configure, basics, map, shapes, textures, frame;
+  ld total() { return teardown + configure + basics + map + shapes + textures + frame; }
+  /** the resident memory before the switch, and the peak during it */
+  int start_kb, peak_kb;
+  };
+#endif
+
+/** switch to the target and measure the time of each phase */
+EX switch_times measure_switch(const switch_target& t) {
+  switch_times res;
+  res.start_kb = memory_kb("VmRSS");
+  reset_peak_memory();
+  auto t0 = profile_clock();
+  auto phase = [&] (ld& into) { auto t1 = profile_clock(); into = (t1 - t0) / 1e6; t0 = t1; };
+  stop_game();
+  phase(res.teardown);
+  t.setup();
+  phase(res.configure);
+  check_cgi();
+  cgi.require_basics();
+  phase(res.basics);
+  start_game();
+  phase(res.map);
+  cgi.require_shapes();
+  phase(res.shapes);
+  check_cgi();
+  #if MAXMDIM >= 4
+  if(GDIM == 3 && !floor_textures) make_floor_textures();
+  #endif
+  phase(res.textures);
+  #if CAP_GL
+  drawscreen();
+  if(vid.usingGL) glFinish();
+  #endif
+  phase(res.frame);
+  res.peak_kb = memory_kb("VmHWM");
+  return res;
+  }
+
+/** switch between the default targets, cycles times, and print the results */
+EX void benchmark(int cycles) {
+  auto targets = default_targets();
+  vector<pair<ld, string>> slowest;
+  println(hlog, format("%-24s %9s %9s %9s %9s %9s %9s %9s %9s %9s %9s", "geometry", "teardown", "config", "basics", "map", "shapes", "textures", "frame", "total", "peak MB", "+MB"));
+  for(int i=0; i<cycles; i++) for(auto& t: targets) {
+    auto r = measure_switch(t);
+    println(hlog, format("%-24s %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f %9.1f %9.1f", t.name.c_str(),
+      double(r.teardown), double(r.configure), double(r.basics), double(r.map), double(r.shapes), double(r.textures), double(r.frame), double(r.total()),
+      r.peak_kb / 1024., (r.peak_kb - r.start_kb) / 1024.));
+    slowest.emplace_back(r.total(), t.name + " (cycle " + its(i+1) + ")");
+    }
+  sort(slowest.rbegin(), slowest.rend());
+  println(hlog, "slowest switches:");
+  for(int i=0; i<3 && i<isize(slowest); i++) println(hlog, "  ", slowest[i].second, ": ", slowest[i].first, " ms");
+  }
+
+#if CAP_COMMANDLINE
+int read_args() {
+  using namespace arg;
+  if(0) ;
+  else if(argis("-bench-switch")) {
+    PHASE(3); start_game();
+    shift(); benchmark(argi());
+    }
+  else return 1;
+  return 0;
+  }
+
+auto ah = addHook(hooks_args, 0, read_args);
+#endif
+
+EX }
+}
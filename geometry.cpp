@@ -85,6 +85,24 @@ struct basic_textureinfo {
   vector<glvertex> tvertices; 
   };
 
+/** a part of a batch of shapes built by geometry_information::build_in_parallel; it may only read the vertices which
+ *  existed before the batch, and only build shapes declared directly in geometry_information
+ */
+struct shape_job {
+  string name;
+  /** the shapes built; when the job is run lazily, drawing any of them builds it */
+  vector<hpcshape*> shapes;
+  std::function<void(struct geometry_information&)> build;
+  };
+
+/** a shape_job which is run when one of its shapes is drawn for the first time, see geometry_information::require_model */
+struct lazy_model {
+  shape_job job;
+  /** the value of shcenter when the job was registered */
+  hyperpoint center;
+  bool built;
+  };
+
 /** basic geometry parameters */
 struct geometry_information {
 
@@ -112,6 +130,9 @@ struct geometry_information {
   /** distance from heptagon center to heptagon vertex (either hexf or hcrossf) */
   ld rhexf;
 
+  /** bound on the distance from heptagon center to the centers of the cells drawn together with it (used to cull whole heptagons) */
+  ld patch_radius;
+
   transmatrix heptmove[MAX_EDGE], hexmove[MAX_EDGE];
   transmatrix invhexmove[MAX_EDGE];
 
@@ -376,6 +397,10 @@ hpcshape
   void shift_last_straight(ld z);
   void queueball(const transmatrix& V, ld rad, color_t col, eItem what);
   void make_shadow(hpcshape& sh);
+  void build_in_parallel(const vector<shape_job>& jobs);
+  void register_lazy(const vector<shape_job>& jobs);
+  void require_model(const hpcshape& sh);
+  void require_all_models();
   void make_3d_models();
   
   /* Goldberg parameters */
@@ -394,13 +419,22 @@ hpcshape
 
   /** contains the texture point coordinates for 3D models */
   basic_textureinfo models_texture;
+
+  /** the 3D models built on demand, and the index of the model building each shape */
+  vector<lazy_model> lazy_models;
+  map<const hpcshape*, int> lazy_model_of;
   
-  geometry_information() { last = NULL; state = usershape_state = 0; gpdata = NULL; }
+  geometry_information() { last = NULL; state = usershape_state = 0; gpdata = NULL; rebuilt = false; }
+  ~geometry_information();
   
-  void require_basics() { if(state & 1) return; state |= 1; prepare_basics(); }
-  void require_shapes() { if(state & 2) return; state |= 2; prepare_shapes(); }
+  void require_basics() { if(state & 1) return; state |= 1; timed_prepare(&geometry_information::prepare_basics); }
+  void require_shapes() { if(state & 2) return; state |= 2; timed_prepare(&geometry_information::prepare_shapes); }
   void require_usershapes() { if(usershape_state == usershape_changes) return; usershape_state = usershape_changes; prepare_usershapes(); }
+  void timed_prepare(void (geometry_information::*f)());
+  size_t memory_usage();
   int timestamp;
+  /** true if this geometry has been evicted from cgis before, so building it again counts as a rebuild */
+  bool rebuilt;
   };
 #endif
 
@@ -539,6 +573,14 @@ void geometry_information::prepare_basics() {
   #if CAP_IRR
   irr::compute_geometry();
   #endif
+  patch_radius = BITRUNCATED ? crossf : 0;
+  #if CAP_GP
+  /* Goldberg cells lie in the triangles formed by the adjacent heptagon centers */
+  if(GOLDBERG) patch_radius = tessf;
+  #endif
+  #if CAP_IRR
+  if(IRREGULAR) patch_radius = irr::patch_radius();
+  #endif
   #if CAP_ARCM
   if(archimedean) {
     arcm::current.compute_geometry();
@@ -906,6 +948,105 @@ EX int last_texture_step;
 
 int ntimestamp;
 
+#if HDR
+/** statistics of the cache of geometry_information instances, see check_cgi */
+struct cgi_statistics {
+  /** switches to a geometry which was still in cgis */
+  int hits;
+  /** switches to a geometry which had to be created; rebuilds are the misses on geometries evicted earlier */
+  int misses, rebuilds;
+  int evictions;
+  /** time spent in prepare_basics and prepare_shapes, in ms, and the part of it spent on rebuilds */
+  ld build_ms, rebuild_ms;
+  };
+#endif
+
+EX cgi_statistics cgi_stats;
+
+/** the geometries no longer in cgis are evicted (least recently used first) until cgis fits in this many megabytes */
+EX int cgi_budget_mb = 512;
+
+/** the keys of evicted geometries, to recognize rebuilds */
+set<string> evicted_cgis;
+
+void evict_cgis();
+
+void geometry_information::timed_prepare(void (geometry_information::*f)()) {
+  auto t0 = profile_clock();
+  (this->*f)();
+  ld ms = (profile_clock() - t0) / 1e6;
+  cgi_stats.build_ms += ms;
+  if(rebuilt) cgi_stats.rebuild_ms += ms;
+  /* the new geometry has grown, so the others might no longer fit */
+  if(this == cgip) evict_cgis();
+  }
+
+template<class T> size_t vector_bytes(const vector<T>& v) { return v.capacity() * sizeof(T); }
+
+size_t floorshape_bytes(const floorshape& fsh) {
+  size_t res = vector_bytes(fsh.b) + vector_bytes(fsh.shadow) + vector_bytes(fsh.cone[0]) + vector_bytes(fsh.cone[1]);
+  for(int i=0; i<SIDEPARS; i++) {
+    res += vector_bytes(fsh.side[i]) + vector_bytes(fsh.levels[i]);
+    for(int j=0; j<MAX_EDGE; j++) res += vector_bytes(fsh.gpside[i][j]);
+    }
+  return res;
+  }
+
+/** the number of bytes used by this geometry_information, including the data owned by its containers */
+size_t geometry_information::memory_usage() {
+  size_t res = sizeof(geometry_information);
+  res += vector_bytes(hpc) + vector_bytes(ourshape) + vector_bytes(models_texture.tvertices);
+  res += vector_bytes(walltester) + vector_bytes(wallstart) + vector_bytes(raywall) + vector_bytes(walloffsets) + vector_bytes(symmetriesAt);
+  for(auto v: {&shPlainWall3D, &shWireframe3D, &shWall3D, &shMiniWall3D}) res += vector_bytes(*v);
+  for(auto& cr: cellrotations) res += sizeof(cr) + vector_bytes(cr.second);
+  res += vector_bytes(allshapes) + vector_bytes(all_plain_floorshapes) + vector_bytes(all_escher_floorshapes);
+  for(auto fsh: all_plain_floorshapes) res += floorshape_bytes(*fsh);
+  for(auto fsh: all_escher_floorshapes) res += floorshape_bytes(*fsh);
+  /* a map node holds the value and three pointers and a color */
+  res += ushr.size() * (sizeof(pair<usershapelayer* const, hpcshape>) + 4 * sizeof(void*));
+  res += lazy_model_of.size() * (sizeof(pair<const hpcshape* const, int>) + 4 * sizeof(void*));
+  for(auto& lm: lazy_models) res += sizeof(lm) + lm.job.name.capacity() + vector_bytes(lm.job.shapes);
+  #if CAP_GP
+  if(gpdata) res += sizeof(gpdata_t);
+  #endif
+  return res;
+  }
+
+/** evict the least recently used geometries until cgis fits in cgi_budget_mb; the current geometry, and the underlying geometry in hybrid geometries, are never evicted */
+void evict_cgis() {
+  vector<pair<int, string>> timestamps;
+  size_t total = 0;
+  for(auto& t: cgis) {
+    total += t.second.memory_usage();
+    timestamps.emplace_back(t.second.timestamp, t.first);
+    }
+  sort(timestamps.begin(), timestamps.end());
+  size_t budget = size_t(cgi_budget_mb) << 20;
+  for(auto& ts: timestamps) {
+    if(total <= budget) break;
+    auto& g = cgis[ts.second];
+    if(&g == cgip || (hybri && &g == hybrid::underlying_cgip)) continue;
+    size_t bytes = g.memory_usage();
+    println(hlog, "erasing geometry ", ts.second, " (", int(bytes >> 10), " KB)");
+    total -= bytes;
+    evicted_cgis.insert(ts.second);
+    cgi_stats.evictions++;
+    cgis.erase(ts.second);
+    }
+  }
+
+EX void print_cgi_stats() {
+  size_t total = 0;
+  for(auto& t: cgis) {
+    size_t bytes = t.second.memory_usage();
+    total += bytes;
+    println(hlog, int(bytes >> 10), " KB", &t.second == cgip ? " (current)" : "", ": ", t.first);
+    }
+  auto& s = cgi_stats;
+  println(hlog, "geometries: ", isize(cgis), " using ", int(total >> 20), " of ", cgi_budget_mb, " MB; hits: ", s.hits, " misses: ", s.misses, " rebuilds: ", s.rebuilds, " evictions: ", s.evictions);
+  println(hlog, "build time: ", s.build_ms, " ms, of which rebuilds: ", s.rebuild_ms, " ms");
+  }
+
 EX void check_cgi() {
   string s;
   auto V = [&] (string a, string b) { s += a; s += ": "; s += b; s += "; "; };
@@ -954,20 +1095,22 @@ EX void check_cgi() {
 
   V("LQ", its(vid.linequality));
   
-  cgip = &cgis[s];
+  auto old = cgip;
+  auto it = cgis.find(s);
+  if(it == cgis.end()) {
+    cgi_stats.misses++;
+    cgip = &cgis[s];
+    if(evicted_cgis.count(s)) cgi_stats.rebuilds++, cgi.rebuilt = true;
+    }
+  else {
+    cgip = &it->second;
+    if(cgip != old) cgi_stats.hits++;
+    }
   cgi.timestamp = ++ntimestamp;
   if(hybri) hybrid::underlying_cgip->timestamp = ntimestamp;
   
-  if(isize(cgis) > 4) {
-    vector<pair<int, string>> timestamps;
-    for(auto& t: cgis) timestamps.emplace_back(-t.second.timestamp, t.first);
-    sort(timestamps.begin(), timestamps.end());
-    while(isize(timestamps) > 4) {
-      println(hlog, "erasing geometry ", timestamps.back().second);
-      cgis.erase(timestamps.back().second);
-      timestamps.pop_back();
-      }
-    }
+  if(cgip != old) evict_cgis();
+  if(cgip != old && (cgi.state & 2)) glhr::store_in_buffer(cgi.ourshape);
   
   if(floor_textures && last_texture_step != vid.texture_step) {
     println(hlog, "changed ", last_texture_step, " to ", vid.texture_step);
@@ -989,4 +1132,22 @@ void clear_cgis() {
 
 auto ah_clear_geo = addHook(hooks_clear_cache, 0, clear_cgis);
 
+#if CAP_COMMANDLINE
+int read_cgi_args() {
+  using namespace arg;
+  if(0) ;
+  else if(argis("-cgi-budget")) {
+    shift(); cgi_budget_mb = argi();
+    }
+  else if(argis("-cgi-stats")) {
+    PHASEFROM(3);
+    print_cgi_stats();
+    }
+  else return 1;
+  return 0;
+  }
+
+auto ah_cgi_args = addHook(hooks_args, 0, read_cgi_args);
+#endif
+
 }
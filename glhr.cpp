@@ -121,7 +121,10 @@ typedef const void *constvoidptr;
 EX constvoidptr current_vertices, buffered_vertices;
 EX ld current_linewidth;
 
-GLuint buf_current, buf_buffered;
+GLuint buf_current, buf_buffered, buf_instances;
+
+/** keep the vertices of the current geometry (cgi.ourshape) in a buffer on the GPU even without CAP_VERTEXBUFFER */
+EX bool resident_buffer = true;
 
 void display(const glmatrix& m) {
   for(int i=0; i<4; i++) {
@@ -260,6 +263,7 @@ struct GLprogram {
   string _vsh, _fsh;
   
   GLprogram(string vsh, string fsh);
+  void get_uniforms();
 
   ~GLprogram();
   };
@@ -329,6 +333,13 @@ GLprogram::GLprogram(string vsh, string fsh) {
   add_fixed_functions(vsh);
   add_fixed_functions(fsh);
   
+  vertShader = fragShader = 0;
+  if(progcache::load(_program, vsh, fsh)) {
+    get_uniforms();
+    return;
+    }
+  auto t0 = profile_clock();
+
   // printf("creating program %d\n", _program);
   vertShader = compileShader(GL_VERTEX_SHADER, vsh.c_str());
   fragShader = compileShader(GL_FRAGMENT_SHADER, fsh.c_str());
@@ -342,7 +353,9 @@ GLprogram::GLprogram(string vsh, string fsh) {
   glBindAttribLocation(_program, aPosition, "aPosition");
   glBindAttribLocation(_program, aTexture, "aTexture");
   glBindAttribLocation(_program, aColor, "aColor");
+  glBindAttribLocation(_program, aInstance, "aInstance");
 
+  progcache::prepare(_program);
   GLint status;
   glLinkProgram(_program);
     
@@ -360,7 +373,14 @@ GLprogram::GLprogram(string vsh, string fsh) {
     printf("failed to link shader\n");
     exit(1);
     }
-  
+
+  progcache::compiled++;
+  progcache::compile_ms += (profile_clock() - t0) / 1e6;
+  progcache::save(_program, vsh, fsh);
+  get_uniforms();
+  }
+
+void GLprogram::get_uniforms() {
   uMV = glGetUniformLocation(_program, "uMV");
   uProjection = glGetUniformLocation(_program, "uP");
   uPP = glGetUniformLocation(_program, "uPP");
@@ -564,6 +584,16 @@ EX void full_enable(shared_ptr<GLprogram> p) {
   if(oldflags & GF_LIGHTFOG) {
     WITHSHADER({}, {glDisable(GL_FOG);})
     }
+  #if CAP_INSTANCING
+  if(newflags & GF_INSTANCED) for(int i=0; i<4; i++) {
+    glEnableVertexAttribArray(aInstance+i);
+    glVertexAttribDivisor(aInstance+i, 1);
+    }
+  if(oldflags & GF_INSTANCED) for(int i=0; i<4; i++) {
+    glVertexAttribDivisor(aInstance+i, 0);
+    glDisableVertexAttribArray(aInstance+i);
+    }
+  #endif
   WITHSHADER({
     glUniform1f(cur->uFogBase, 1); fogbase = 1;
     }, {})
@@ -641,6 +671,40 @@ void init() {
   current_vertices = NULL;
   buffered_vertices = (void*) &buffered_vertices; // point to nothing
   glBindBuffer(GL_ARRAY_BUFFER, buf_current);
+  #else
+  buffered_vertices = nullptr;
+  if(!noshaders) {
+    glGenBuffers(1, &buf_buffered);
+    glGenBuffers(1, &buf_instances);
+    }
+  #endif
+  }
+
+/** instanced drawing needs OpenGL 3.3 (glVertexAttribDivisor and glDrawArraysInstanced) */
+EX bool instancing_supported() {
+  #if CAP_INSTANCING
+  static int result = -1;
+  if(result == -1) {
+    int major = 0, minor = 0;
+    auto ver = (const char*) glGetString(GL_VERSION);
+    if(ver) sscanf(ver, "%d.%d", &major, &minor);
+    result = !noshaders && (major > 3 || (major == 3 && minor >= 3));
+    DEBB(DF_GRAPH, ("GL version ", ver ? ver : "unknown", ", instancing ", result ? "supported" : "not supported"));
+    }
+  return result;
+  #else
+  return false;
+  #endif
+  }
+
+/** the model matrices for the next instanced draw, see GF_INSTANCED */
+EX void instance_matrices(const vector<glmatrix>& m) {
+  #if CAP_INSTANCING
+  glBindBuffer(GL_ARRAY_BUFFER, buf_instances);
+  glBufferData(GL_ARRAY_BUFFER, isize(m) * sizeof(glmatrix), &m[0], GL_STREAM_DRAW);
+  for(int i=0; i<4; i++)
+    glVertexAttribPointer(aInstance+i, 4, GL_FLOAT, GL_FALSE, sizeof(glmatrix), (void*) (sizeof(GLfloat) * 4 * i));
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
   #endif
   }
 
@@ -686,6 +750,12 @@ EX void vertices(const vector<glvertex>& v, int vshift IS(0)) {
   #else
   if(current_vertices == &v[vshift]) return;
   current_vertices = &v[vshift];
+  if(&v[0] == buffered_vertices && !noshaders) {
+    glBindBuffer(GL_ARRAY_BUFFER, buf_buffered);
+    glVertexAttribPointer(aPosition, SHDIM, GL_FLOAT, GL_FALSE, sizeof(glvertex), (void*) (sizeof(glvertex) * vshift));
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return;
+    }
   WITHSHADER(
     glVertexAttribPointer(aPosition, SHDIM, GL_FLOAT, GL_FALSE, sizeof(glvertex), &v[vshift]);,
     glVertexPointer(SHDIM, GL_FLOAT, sizeof(glvertex), &v[0]);
@@ -781,9 +851,26 @@ EX void store_in_buffer(vector<glvertex>& v) {
   glVertexAttribPointer(aPosition, SHDIM, GL_FLOAT, GL_FALSE, sizeof(glvertex), 0);
   glBufferData(GL_ARRAY_BUFFER, isize(v) * sizeof(glvertex), &v[0], GL_STATIC_DRAW);
   printf("Stored.\n");
+#else
+  buffered_vertices = nullptr;
+  current_vertices = nullptr;
+  if(!resident_buffer || noshaders || !buf_buffered || v.empty()) return;
+  glBindBuffer(GL_ARRAY_BUFFER, buf_buffered);
+  glBufferData(GL_ARRAY_BUFFER, isize(v) * sizeof(glvertex), &v[0], GL_STATIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  buffered_vertices = &v[0];
+  DEBB(DF_GRAPH, ("stored ", isize(v), " vertices in the resident buffer"));
 #endif
   }
 
+/** v is about to be freed or moved; stop drawing it from the resident buffer */
+EX void forget_buffer(const vector<glvertex>& v) {
+  #if !CAP_VERTEXBUFFER
+  if(!v.empty() && buffered_vertices == &v[0]) buffered_vertices = nullptr;
+  if(!v.empty() && current_vertices >= (const void*) &v[0] && current_vertices < (const void*) (&v[0] + isize(v))) current_vertices = nullptr;
+  #endif
+  }
+
 EX void set_depthtest(bool b) {
   if(b != current_depthtest) {
     current_depthtest = b;
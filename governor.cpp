@@ -0,0 +1,157 @@
+// Hyperbolic Rogue -- frame budget governor
+// Copyright (C) 2011-2020 Zeno Rogue, see 'hyper.cpp' for details
+
+/** \file governor.cpp
+ *  \brief adapt the sight range and the detail to keep the frame time within a budget
+ *
+ *  The governor measures the time spent on drawing each frame. When it stays above the budget,
+ *  one knob is lowered: the sight range (or the smart range detail) when traversing and drawing
+ *  the cells dominates, otherwise the per-cell detail level and then the line quality. When the
+ *  frame time stays well below the budget, the most recent reduction is undone. The user settings
+ *  themselves are never changed: the reductions are only applied while drawing the map.
+ */
+
+#include "hyper.h"
+namespace hr {
+
+EX namespace governor {
+
+/** the frame time budget in milliseconds; 0 = the governor is off */
+EX int target_ms = 0;
+
+/** reduce the quality when the frame time exceeds the budget by this factor */
+EX ld slow_factor = 1.1;
+
+/** restore the quality when the frame time is below the budget times this factor */
+EX ld fast_factor = 0.6;
+
+/** the number of frames the frame time has to be out of the range before the level changes */
+EX int patience = 10;
+
+#if HDR
+enum eKnob { kRange, kDetail, kLines, kGUARD };
+#endif
+
+/** maximum number of reductions of each knob */
+const int knob_max[kGUARD] = { 3, 2, 2 };
+
+/** the reductions currently in effect, in the order they were made */
+EX vector<eKnob> steps;
+
+EX int reductions(eKnob k) {
+  int res = 0;
+  for(auto s: steps) if(s == k) res++;
+  return res;
+  }
+
+EX int level() { return isize(steps); }
+
+/** the maximum detail level allowed by the governor */
+EX int max_detail() { return 2 - reductions(kDetail); }
+
+ld avg_ms;
+int frames_slow, frames_fast, cooldown;
+
+EX bool active() { return target_ms > 0 && !inHighQual; }
+
+#if HDR
+/** apply the reductions while drawing a frame */
+struct scope {
+  bool on;
+  long long start;
+  int sightrange_bonus, linequality;
+  ld smart_range_detail, smart_range_detail_3, sightrange;
+  dynamicval<bool> dp;
+  scope();
+  ~scope();
+  };
+#endif
+
+scope::scope() : on(active()), dp(profiling, profiling || active()) {
+  start = profile_clock();
+  if(!on) return;
+  sightrange_bonus = hr::sightrange_bonus;
+  linequality = vid.linequality;
+  smart_range_detail = vid.smart_range_detail;
+  smart_range_detail_3 = vid.smart_range_detail_3;
+  sightrange = sightranges[geometry];
+
+  int r = reductions(kRange);
+  if(vid.use_smart_range) {
+    vid.smart_range_detail *= pow(1.5, r);
+    vid.smart_range_detail_3 *= pow(1.5, r);
+    }
+  else if(WDIM == 3)
+    sightranges[geometry] *= pow(.85, r);
+  else
+    hr::sightrange_bonus = max(hr::sightrange_bonus - r, 1 - getDistLimit());
+  vid.linequality = max(vid.linequality - reductions(kLines), -3);
+  }
+
+scope::~scope() {
+  if(!on) return;
+  hr::sightrange_bonus = sightrange_bonus;
+  vid.linequality = linequality;
+  vid.smart_range_detail = smart_range_detail;
+  vid.smart_range_detail_3 = smart_range_detail_3;
+  sightranges[geometry] = sightrange;
+  }
+
+void change(bool reduce) {
+  if(!reduce) steps.pop_back();
+  else {
+    /* lower the knob responsible for the dominant stage, if possible */
+    ld cells = proftable[prof_mapdraw][pframeid];
+    ld render = proftable[prof_queue][pframeid];
+    vector<eKnob> order = cells > render ? vector<eKnob>{kRange, kDetail, kLines} : vector<eKnob>{kDetail, kLines, kRange};
+    for(auto k: order) if(reductions(k) < knob_max[k]) { steps.push_back(k); break; }
+    }
+  frames_slow = frames_fast = 0;
+  /* the first frames after a change may be slow (the shapes are rebuilt for a new line quality), so they are not measured */
+  cooldown = patience;
+  avg_ms = 0;
+  }
+
+/** called after each frame drawn in the scope */
+EX void update(const scope& sc) {
+  if(!sc.on) return;
+  ld ms = (profile_clock() - sc.start) / 1e6;
+  if(cooldown) { cooldown--; return; }
+  avg_ms = avg_ms ? avg_ms * .8 + ms * .2 : ms;
+  if(avg_ms > target_ms * slow_factor) frames_slow++, frames_fast = 0;
+  else if(avg_ms < target_ms * fast_factor) frames_fast++, frames_slow = 0;
+  else frames_slow = frames_fast = 0;
+  if(frames_slow >= patience && level() < knob_max[kRange] + knob_max[kDetail] + knob_max[kLines]) change(true);
+  else if(frames_fast >= 2 * patience && level()) change(false);
+  }
+
+/** the current reductions, as shown on the HUD */
+EX string info() {
+  return "L" + its(level()) + " (range -" + its(reductions(kRange)) + ", detail -" + its(reductions(kDetail)) + ", lines -" + its(reductions(kLines)) + ")";
+  }
+
+EX void reset() {
+  steps.clear();
+  frames_slow = frames_fast = cooldown = 0;
+  avg_ms = 0;
+  }
+
+#if CAP_COMMANDLINE
+int read_args() {
+  using namespace arg;
+  if(0) ;
+  else if(argis("-governor")) {
+    shift(); target_ms = argi(); reset();
+    }
+  else if(argis("-governor-patience")) {
+    shift(); patience = argi();
+    }
+  else return 1;
+  return 0;
+  }
+
+auto ah = addHook(hooks_args, 0, read_args);
+#endif
+
+EX }
+}
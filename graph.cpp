@@ -3738,6 +3738,7 @@ EX void set_detail_level(const transmatrix& V) {
   else if(dist0 < vid.highdetail) detaillevel = 2;
   else if(dist0 < vid.middetail) detaillevel = 1;
   else detaillevel = 0;
+  detaillevel = min(detaillevel, governor::max_detail());
 
   if((cmode & sm::NUMBER) && (dialog::editingDetail())) {
     color_t col = 
@@ -4359,6 +4360,7 @@ EX void drawthemap() {
   frameid++;
   cells_drawn = 0;
   cells_generated = 0;
+  patches_culled = cells_culled = 0;
   noclipped = 0;
   first_cell_to_draw = true;
   
@@ -4366,7 +4368,7 @@ EX void drawthemap() {
     sightrange_bonus = 0;
   
   profile_frame();
-  profile_start(0);
+  profile_start(prof_drawthemap);
   swap(gmatrix0, gmatrix);
   gmatrix.clear();
 
@@ -4436,7 +4438,7 @@ EX void drawthemap() {
   
   arrowtraps.clear();
 
-  profile_start(1);
+  profile_start(prof_mapdraw);
   make_actual_view();
   currentmap->draw();
   drawWormSegments();
@@ -4451,10 +4453,10 @@ EX void drawthemap() {
   
   callhooks(hooks_frame);
   
-  profile_stop(1);
-  profile_start(4);
+  profile_stop(prof_mapdraw);
+  profile_start(prof_markers);
   drawMarkers();
-  profile_stop(4);
+  profile_stop(prof_markers);
   drawFlashes();
   
   if(multi::players > 1 && !shmup::on) {
@@ -4510,7 +4512,7 @@ EX void drawthemap() {
     lmouseover = mousedest.d >= 0 ? cwt.at->modmove(cwt.spin + mousedest.d) : cwt.at;
     }
   #endif
-  profile_stop(0);
+  profile_stop(prof_drawthemap);
   }
 
 EX void drawmovestar(double dx, double dy) {
@@ -4645,7 +4647,8 @@ bool force_sphere_outline = false;
 EX void drawfullmap() {
 
   DEBBI(DF_GRAPH, ("draw full map"));
-    
+
+  governor::scope gs;
   check_cgi();
   cgi.require_shapes();
 
@@ -4697,14 +4700,15 @@ EX void drawfullmap() {
     if(cmode & sm::DRAW) mapeditor::drawGrid();
 #endif
     }
-  profile_start(2);
+  profile_start(prof_queue);
 
   drawaura();
   #if CAP_QUEUE
   drawqueue();
   #endif
 
-  profile_stop(2);
+  profile_stop(prof_queue);
+  governor::update(gs);
   }
 
 #if ISMOBILE
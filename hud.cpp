@@ -604,6 +604,7 @@ EX void drawStats() {
     }
   string vers = VER;
   if(!nofps) vers += XLAT(" fps: ") + its(calcfps());
+  if(governor::target_ms) vers += " " + governor::info();
   
   #if CAP_MEMORY_RESERVE
   if(reserve_limit && reserve_count < reserve_limit) {
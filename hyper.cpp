@@ -26,6 +26,7 @@
 #include "glhr.cpp"
 #include "shaders.cpp"
 #include "raycaster.cpp"
+#include "raycpu.cpp"
 #include "hprint.cpp"
 #include "util.cpp"
 #include "hyperpoint.cpp"
@@ -69,7 +70,11 @@
 #include "3d-models.cpp"
 #include "floorshapes.cpp"
 #include "usershapes.cpp"
+#include "shapecache.cpp"
+#include "progcache.cpp"
 #include "drawing.cpp"
+#include "swrender.cpp"
+#include "governor.cpp"
 #include "mapeditor.cpp"
 #include "netgen.cpp"
 #include "nofont.cpp"
@@ -83,6 +88,7 @@
 #include "dialogs.cpp"
 #include "menus.cpp"
 #include "geom-exp.cpp"
+#include "geom-bench.cpp"
 #include "quit.cpp"
 #include "multi.cpp"
 #include "shmup.cpp"
@@ -186,6 +186,93 @@ constexpr hyperpoint C03 = hyperpoint(0,0,0,1);
 
 /** C0 is the origin in our space */
 #define C0 (MDIM == 3 ? C02 : C03)
+
+/** \brief lanes for the batched kernels
+ *
+ *  A batched kernel processes SIMD_LANES hyperpoints at once: simd_load transposes them
+ *  into one simd_ld per coordinate, and simd_store transposes them back. The kernels are written
+ *  once, using the arithmetic operators (GCC and Clang provide them for the SSE/AVX types);
+ *  without CAP_SIMD there is just one lane of ld, so the same code becomes the scalar fallback.
+ */
+#if CAP_SIMD && defined(__AVX__)
+typedef __m256d simd_ld;
+static const int SIMD_LANES = 4;
+inline simd_ld simd_const(ld x) { return _mm256_set1_pd(x); }
+inline simd_ld simd_sqrt(simd_ld x) { return _mm256_sqrt_pd(x); }
+inline simd_ld simd_min(simd_ld x, simd_ld y) { return _mm256_min_pd(x, y); }
+inline simd_ld simd_max(simd_ld x, simd_ld y) { return _mm256_max_pd(x, y); }
+/** a < b ? x : y, lane by lane */
+inline simd_ld simd_if_less(simd_ld a, simd_ld b, simd_ld x, simd_ld y) { return _mm256_blendv_pd(y, x, _mm256_cmp_pd(a, b, _CMP_LT_OQ)); }
+/** a == b ? x : y, lane by lane */
+inline simd_ld simd_if_equal(simd_ld a, simd_ld b, simd_ld x, simd_ld y) { return _mm256_blendv_pd(y, x, _mm256_cmp_pd(a, b, _CMP_EQ_OQ)); }
+inline void simd_transpose(simd_ld& a, simd_ld& b, simd_ld& c, simd_ld& d) {
+  simd_ld t0 = _mm256_unpacklo_pd(a, b), t1 = _mm256_unpackhi_pd(a, b);
+  simd_ld t2 = _mm256_unpacklo_pd(c, d), t3 = _mm256_unpackhi_pd(c, d);
+  a = _mm256_permute2f128_pd(t0, t2, 0x20); b = _mm256_permute2f128_pd(t1, t3, 0x20);
+  c = _mm256_permute2f128_pd(t0, t2, 0x31); d = _mm256_permute2f128_pd(t1, t3, 0x31);
+  }
+inline void simd_load(const hyperpoint *h, simd_ld& x, simd_ld& y, simd_ld& z, simd_ld& w) {
+  x = _mm256_loadu_pd(&h[0][0]); y = _mm256_loadu_pd(&h[1][0]);
+  z = _mm256_loadu_pd(&h[2][0]); w = _mm256_loadu_pd(&h[3][0]);
+  simd_transpose(x, y, z, w);
+  }
+inline void simd_store(hyperpoint *h, simd_ld x, simd_ld y, simd_ld z, simd_ld w) {
+  simd_transpose(x, y, z, w);
+  _mm256_storeu_pd(&h[0][0], x); _mm256_storeu_pd(&h[1][0], y);
+  _mm256_storeu_pd(&h[2][0], z); _mm256_storeu_pd(&h[3][0], w);
+  }
+#elif CAP_SIMD
+typedef __m128d simd_ld;
+static const int SIMD_LANES = 2;
+inline simd_ld simd_const(ld x) { return _mm_set1_pd(x); }
+inline simd_ld simd_sqrt(simd_ld x) { return _mm_sqrt_pd(x); }
+inline simd_ld simd_min(simd_ld x, simd_ld y) { return _mm_min_pd(x, y); }
+inline simd_ld simd_max(simd_ld x, simd_ld y) { return _mm_max_pd(x, y); }
+inline simd_ld simd_select(simd_ld mask, simd_ld x, simd_ld y) { return _mm_or_pd(_mm_and_pd(mask, x), _mm_andnot_pd(mask, y)); }
+inline simd_ld simd_if_less(simd_ld a, simd_ld b, simd_ld x, simd_ld y) { return simd_select(_mm_cmplt_pd(a, b), x, y); }
+inline simd_ld simd_if_equal(simd_ld a, simd_ld b, simd_ld x, simd_ld y) { return simd_select(_mm_cmpeq_pd(a, b), x, y); }
+inline void simd_load(const hyperpoint *h, simd_ld& x, simd_ld& y, simd_ld& z, simd_ld& w) {
+  simd_ld a01 = _mm_loadu_pd(&h[0][0]), a23 = _mm_loadu_pd(&h[0][2]);
+  simd_ld b01 = _mm_loadu_pd(&h[1][0]), b23 = _mm_loadu_pd(&h[1][2]);
+  x = _mm_unpacklo_pd(a01, b01); y = _mm_unpackhi_pd(a01, b01);
+  z = _mm_unpacklo_pd(a23, b23); w = _mm_unpackhi_pd(a23, b23);
+  }
+inline void simd_store(hyperpoint *h, simd_ld x, simd_ld y, simd_ld z, simd_ld w) {
+  _mm_storeu_pd(&h[0][0], _mm_unpacklo_pd(x, y)); _mm_storeu_pd(&h[0][2], _mm_unpacklo_pd(z, w));
+  _mm_storeu_pd(&h[1][0], _mm_unpackhi_pd(x, y)); _mm_storeu_pd(&h[1][2], _mm_unpackhi_pd(z, w));
+  }
+#else
+typedef ld simd_ld;
+static const int SIMD_LANES = 1;
+inline simd_ld simd_const(ld x) { return x; }
+inline simd_ld simd_sqrt(simd_ld x) { return sqrt(x); }
+inline simd_ld simd_min(simd_ld x, simd_ld y) { return min(x, y); }
+inline simd_ld simd_max(simd_ld x, simd_ld y) { return max(x, y); }
+inline simd_ld simd_if_less(simd_ld a, simd_ld b, simd_ld x, simd_ld y) { return a < b ? x : y; }
+inline simd_ld simd_if_equal(simd_ld a, simd_ld b, simd_ld x, simd_ld y) { return a == b ? x : y; }
+inline void simd_load(const hyperpoint *h, simd_ld& x, simd_ld& y, simd_ld& z, simd_ld& w) {
+  x = h[0][0]; y = h[0][1]; z = h[0][2]; w = MAXMDIM == 4 ? h[0][MAXMDIM-1] : 0;
+  }
+inline void simd_store(hyperpoint *h, simd_ld x, simd_ld y, simd_ld z, simd_ld w) {
+  h[0][0] = x; h[0][1] = y; h[0][2] = z; if(MAXMDIM == 4) h[0][MAXMDIM-1] = w;
+  }
+#endif
+
+/** run kernel(in, out) on groups of SIMD_LANES points; the last group is padded */
+template<class T> void simd_batch(const hyperpoint *in, hyperpoint *out, int n, const T& kernel) {
+  int i = 0;
+  for(; i + SIMD_LANES <= n; i += SIMD_LANES) kernel(in+i, out+i);
+  if(i < n) {
+    hyperpoint bin[SIMD_LANES], bout[SIMD_LANES];
+    for(int j=0; j<SIMD_LANES; j++) bin[j] = in[min(i+j, n-1)];
+    kernel(bin, bout);
+    for(int j=0; i+j<n; j++) out[i+j] = bout[j];
+    }
+  }
+
+/** for the kernels which need to do some work lane by lane */
+inline void simd_to_array(simd_ld v, ld *a) { memcpy(a, &v, sizeof(v)); }
+inline simd_ld simd_from_array(const ld *a) { simd_ld v; memcpy(&v, a, sizeof(v)); return v; }
 #endif
 
 // basic functions and types
@@ -1165,6 +1252,17 @@ EX hyperpoint inverse_exp(const hyperpoint h, iePrecision p, bool just_direction
   return v;
   }
 
+/** res[i] = inverse_exp(h[i], p, just_direction) for i<n; in Sol and NIH the tables are interpolated in batches; h and res may be the same array */
+EX void inverse_exp_batch(const hyperpoint *h, hyperpoint *res, int n, iePrecision p, bool just_direction IS(true)) {
+  #if CAP_SOLV
+  if(solnih) {
+    solnihv::get_inverse_exp_batch(h, res, n, p == iLazy, just_direction);
+    return;
+    }
+  #endif
+  for(int i=0; i<n; i++) res[i] = inverse_exp(h[i], p, just_direction);
+  }
+
 EX ld geo_dist(const hyperpoint h1, const hyperpoint h2, iePrecision p) {
   if(!nonisotropic) return hdist(h1, h2);
   return hypot_d(3, inverse_exp(inverse(nisot::translate(h1)) * h2, p, false));
@@ -873,6 +873,183 @@ EX void applymodel(hyperpoint H, hyperpoint& ret) {
   ghcheck(ret,H_orig);
   }
 
+/** the same as applymodel(H[i], ret[i]) for i<n, but the common models are computed SIMD_LANES points at a time; H and ret may be the same array */
+EX void applymodel_batch(const hyperpoint *H, hyperpoint *ret, int n) {
+
+  bool in_product = models::product_model();
+
+  if(pmodel == mdDisk && !in_product && !nonisotropic && !vid.camera_angle) {
+    simd_ld alpha = simd_const(vid.alpha);
+    simd_ld etz = simd_const(1 + vid.alpha);
+    simd_ld limit = simd_const(BEHIND_LIMIT);
+    simd_ld eye = simd_const(vid.xres * current_display->eyewidth() / 2 / current_display->radius);
+    simd_ld ipd = simd_const(vid.ipd / 2);
+    simd_ld one = simd_const(1);
+    bool threed = GDIM == 3;
+    bool eucl = euclid;
+    simd_batch(H, ret, n, [&] (const hyperpoint *in, hyperpoint *out) {
+      simd_ld x, y, z, w;
+      simd_load(in, x, y, z, w);
+      simd_ld tz = eucl ? etz : alpha + (threed ? w : z);
+      tz = simd_if_less(simd_max(tz, -tz), limit, limit, tz);
+      simd_store(out, x / tz, y / tz, threed ? z / tz : eye - ipd / tz, one);
+      });
+    return;
+    }
+  if(pmodel == mdHalfplane && !in_product && GDIM == 2 && !spatial_graphics) {
+    simd_ld alpha = simd_const(vid.alpha);
+    simd_ld oc = simd_const(models::ocos), os = simd_const(models::osin);
+    simd_ld hs = simd_const(models::halfplane_scale);
+    simd_ld zero = simd_const(0), half = simd_const(.5), one = simd_const(1);
+    bool straight = models::model_straight;
+    auto orient = [&] (simd_ld& x, simd_ld& y) {
+      if(straight) return;
+      simd_ld x1 = x * oc + y * os;
+      y = y * oc - x * os; x = x1;
+      };
+    simd_batch(H, ret, n, [&] (const hyperpoint *in, hyperpoint *out) {
+      simd_ld x, y, z, w;
+      simd_load(in, x, y, z, w);
+      simd_ld s = one / (alpha + z);
+      x = x * s; y = y * s;
+      orient(x, y);
+      y = y + one;
+      simd_ld rad = zero - (x * x + y * y);
+      x = x / rad; y = y / rad + half;
+      orient(x, y);
+      hyperpoint H_orig[SIMD_LANES];
+      for(int i=0; i<SIMD_LANES; i++) H_orig[i] = in[i];
+      simd_store(out, zero - os - x * hs, oc + y * hs, zero, one);
+      for(int i=0; i<SIMD_LANES; i++) ghcheck(out[i], H_orig[i]);
+      });
+    return;
+    }
+  if(pmodel == mdPerspective && !in_product && GDIM == 3 && !prod) {
+    transmatrix M = nisot::local_perspective_used() ? NLP : Id;
+    simd_ld m[3][4];
+    for(int i=0; i<3; i++) for(int j=0; j<4; j++) m[i][j] = simd_const(M[i][j]);
+    simd_ld ratio = simd_const(vid.xres / current_display->tanfov / current_display->radius / 2);
+    simd_ld zero = simd_const(0), one = simd_const(1), far = simd_const(1e6);
+    simd_batch(H, ret, n, [&] (const hyperpoint *in, hyperpoint *out) {
+      simd_ld x, y, z, w;
+      simd_load(in, x, y, z, w);
+      simd_ld px = m[0][0] * x + m[0][1] * y + m[0][2] * z + m[0][3] * w;
+      simd_ld py = m[1][0] * x + m[1][1] * y + m[1][2] * z + m[1][3] * w;
+      simd_ld pz = m[2][0] * x + m[2][1] * y + m[2][2] * z + m[2][3] * w;
+      simd_ld safe = simd_if_equal(pz, zero, one, pz);
+      simd_store(out, simd_if_equal(pz, zero, far, px / safe * ratio), simd_if_equal(pz, zero, far, py / safe * ratio), one, one);
+      });
+    return;
+    }
+  if(nonisotropic && !in_product && among(pmodel, mdGeodesic, mdDisk, mdFisheye, mdEquidistant, mdEquiarea, mdEquivolume)) {
+    /* these models start with inverse_exp, which is computed for the whole batch */
+    static vector<hyperpoint> ie;
+    ie.resize(n);
+    inverse_exp_batch(H, ie.data(), n, iTable, among(pmodel, mdGeodesic, mdDisk));
+    ld ratio = vid.xres / current_display->tanfov / current_display->radius / 2;
+    for(int i=0; i<n; i++) {
+      hyperpoint S = lp_apply(ie[i]), r = ret[i];
+      switch(pmodel) {
+        case mdGeodesic:
+          r[0] = S[0]/S[2] * ratio;
+          r[1] = S[1]/S[2] * ratio;
+          r[2] = 1;
+          ret[i] = r;
+          continue;
+        case mdDisk: {
+          ld w;
+          if(solnih) w = 1 / (sqrt(1 - sqhypot_d(3, S)) * vid.alpha + 1);
+          else {
+            w = hypot_d(3, S);
+            w = sinh(w) / ((vid.alpha + cosh(w)) * w);
+            }
+          for(int j=0; j<3; j++) r[j] = S[j] * w;
+          r[3] = 1;
+          break;
+          }
+        case mdFisheye:
+          S /= vid.fisheye_param;
+          S[LDIM] = 1;
+          r = S / sqrt(1 + sqhypot_d(GDIM+1, S));
+          if(GDIM == 3) r[LDIM] = 1;
+          break;
+        default:
+          r = S; r[3] = 1;
+          break;
+        }
+      ghcheck(r, H[i]);
+      ret[i] = r;
+      }
+    return;
+    }
+
+  for(int i=0; i<n; i++) applymodel(H[i], ret[i]);
+  }
+
+/** models for which applymodel_batch is benchmarked and tested, with the alpha to use (-1: keep) */
+vector<pair<eModel, ld>> batched_models() {
+  if(nonisotropic) return {{mdGeodesic, -1}, {mdDisk, -1}, {mdEquidistant, -1}, {mdFisheye, -1}};
+  vector<pair<eModel, ld>> res = {{mdDisk, -1}, {mdDisk, 0}};
+  if(GDIM == 2) res.emplace_back(mdHalfplane, -1), res.emplace_back(mdBand, -1);
+  else res.emplace_back(mdPerspective, -1);
+  return res;
+  }
+
+vector<hyperpoint> random_model_points(int n) {
+  vector<hyperpoint> pts(n);
+  /* in the nonisotropic geometries, points in the range of the geodesic tables */
+  if(nonisotropic) for(auto& h: pts) h = point31((randd() - .5) * 10, (randd() - .5) * 10, (randd() - .5) * 4);
+  else for(auto& h: pts) h = random_spin() * xpush(randd() * 5) * C0;
+  return pts;
+  }
+
+/** -bench-models N: points per second for applymodel and applymodel_batch */
+EX void bench_models(int n) {
+  auto pts = random_model_points(n);
+  vector<hyperpoint> res1(n), res2(n);
+  for(auto mp: batched_models()) {
+    dynamicval<eModel> pm(pmodel, mp.first);
+    dynamicval<ld> al(vid.alpha, mp.second == -1 ? vid.alpha : mp.second);
+    int scalar_reps = 0, batch_reps = 0;
+    int t0 = SDL_GetTicks(), t1;
+    while((t1 = SDL_GetTicks()) < t0 + 250 || !scalar_reps) {
+      for(int i=0; i<n; i++) applymodel(pts[i], res1[i]);
+      scalar_reps++;
+      }
+    int t2;
+    while((t2 = SDL_GetTicks()) < t1 + 250 || !batch_reps) {
+      applymodel_batch(pts.data(), res2.data(), n);
+      batch_reps++;
+      }
+    ld err = 0;
+    for(int i=0; i<n; i++) for(int d=0; d<3; d++) err = max(err, abs(res1[i][d] - res2[i][d]));
+    println(hlog, format("%-12s alpha=%4.2f scalar: %12.0f pts/s  batch (%d lanes): %12.0f pts/s  max error %g",
+      models::get_model_name(pmodel).c_str(), double(vid.alpha),
+      1000. * n * scalar_reps / max(t1 - t0, 1), SIMD_LANES, 1000. * n * batch_reps / max(t2 - t1, 1), double(err)));
+    }
+  }
+
+void test_applymodel_batch() {
+  println(hlog, "Testing applymodel_batch...");
+  auto pts = random_model_points(1001);
+  vector<hyperpoint> res(1001);
+  for(auto mp: batched_models()) {
+    dynamicval<eModel> pm(pmodel, mp.first);
+    dynamicval<ld> al(vid.alpha, mp.second == -1 ? vid.alpha : mp.second);
+    applymodel_batch(pts.data(), res.data(), isize(pts));
+    for(int i=0; i<isize(pts); i++) {
+      hyperpoint h;
+      applymodel(pts[i], h);
+      for(int d=0; d<3; d++) if(abs(h[d] - res[i][d]) > 1e-9 * max<ld>(1, abs(h[d]))) {
+        println(hlog, "Failed for ", models::get_model_name(pmodel), " at ", pts[i], ": ", h, " vs ", res[i]);
+        break;
+        }
+      }
+    }
+  }
+
+int batch_tester = addHook(hooks_tests, 0, test_applymodel_batch);
+
 // game-related graphics
 
 EX transmatrix sphereflip; // on the sphere, flip
@@ -1074,6 +1251,53 @@ EX bool in_smart_range(const transmatrix& T) {
     y + 2 * dy > current_display->ytop;
   }
 
+/** the number of heptagons culled as a whole in the last frame, and the number of cells in them */
+EX int patches_culled, cells_culled;
+
+/** can all the cells within distance R from the center of T be skipped because in_smart_range would reject each of them?
+ *  The screen position and scale of a cell are bounded using the scale at the center, so this only works in the conformal
+ *  disk models: the scale changes by at most the factor exp(R) in the Poincare model, and is constant in Euclidean geometry.
+ */
+EX bool patch_out_of_range(const transmatrix& T, ld R) {
+  if(GDIM != 2 || pmodel != mdDisk || vid.camera_angle || vid.stretch != 1) return false;
+  if(!(euclid || (hyperbolic && vid.alpha == 1))) return false;
+  ld K = euclid ? 1 : exp(R);
+
+  hyperpoint h = tC0(T);
+  if(invalid_point(h)) return false;
+  hyperpoint h1;
+  applymodel(h, h1);
+  if(invalid_point(h1)) return false;
+  ld x = current_display->xcenter + current_display->radius * h1[0];
+  ld y = current_display->ycenter + current_display->radius * h1[1] * vid.stretch;
+
+  ld epsilon = 0.01;
+  ld dh[2];
+  for(int i=0; i<2; i++) {
+    hyperpoint h2;
+    applymodel(T * cpush0(i, epsilon), h2);
+    ld x1 = current_display->radius * abs(h2[0] - h1[0]) / epsilon;
+    ld y1 = current_display->radius * abs(h2[1] - h1[1]) / epsilon;
+    dh[i] = hypot(x1, y1);
+    }
+
+  if(sqrt(dh[0] * dh[1]) * K * cgi.scalefactor * hcrossf7 <= vid.smart_range_detail) return true;
+
+  /* a cell is moved by at most R * K * dh, and in_smart_range uses a margin of at most 2 * K * dh around it */
+  ld margin = (R + 2) * K * max(dh[0], dh[1]);
+  return
+    x - margin >= current_display->xtop + current_display->xsize ||
+    x + margin <= current_display->xtop ||
+    y - margin >= current_display->ytop + current_display->ysize ||
+    y + margin <= current_display->ytop;
+  }
+
+/** should the heptagon drawn at V be skipped, together with all its cells? */
+bool cull_patch(const transmatrix& V) {
+  bool usr = vid.use_smart_range || quotient || euwrap;
+  return usr && cells_drawn >= 50 && patch_out_of_range(V, cgi.patch_radius);
+  }
+
 #if CAP_GP
 namespace gp {
 
@@ -1114,6 +1338,19 @@ void drawrec(cell *c, const transmatrix& V) {
     return res;
     }
   
+  /** the number of cells drawn by drawrec(c, V) */
+  int patch_size(cell *c) {
+    int res = 1;
+    for(int i=0; i<c->type; i++) {
+      cell *c2 = c->move(i);
+      if(!c2) continue;
+      if(c2->move(0) != c) continue;
+      if(c2 == c2->master->c7) continue;
+      res += patch_size(c2);
+      }
+    return res;
+    }
+
   bool drawrec(cell *c, const transmatrix& V) {
     draw_li.relative = loc(0,0);
     draw_li.total_dir = 0;
@@ -1185,6 +1422,22 @@ void hrmap_standard::draw() {
     
     if(0) ;
     
+    else if(cull_patch(V1)) {
+      patches_culled++;
+      if(0) ;
+      #if CAP_GP
+      else if(GOLDBERG) cells_culled += gp::patch_size(c);
+      #endif
+      #if CAP_IRR
+      else if(IRREGULAR) cells_culled += isize(irr::cells_of_heptagon[irr::periodmap[hs.at].base.at]);
+      #endif
+      else {
+        cells_culled++;
+        if(BITRUNCATED) for(int d=0; d<S7; d++)
+          if(c->move(d) && c->c.spin(d) == 0) cells_culled++;
+        }
+      }
+    
     #if CAP_GP    
     else if(GOLDBERG) {
       draw = gp::drawrec(c, actualV(hs, V1));
@@ -1940,19 +2193,78 @@ struct bandfixer {
 EX namespace dq {
   EX queue<tuple<heptagon*, transmatrix, ld>> drawqueue;
 
-  EX set<heptagon*> visited;
+  #if HDR
+  /** the position of a cell quantized by bucketer, used to identify the cells in enqueue_by_matrix */
+  struct bucket_key {
+    int x, y, z;
+    bool operator == (const bucket_key& b) const { return x == b.x && y == b.y && z == b.z; }
+    };
+
+  inline uint64_t hash_key(heptagon *h) { return uint64_t(size_t(h)); }
+  inline uint64_t hash_key(const bucket_key& b) { return uint64_t(b.x) * 0x2545F4914F6CDD1Dull ^ uint64_t(b.y) * 0x9E3779B97F4A7C15ull ^ uint64_t(b.z); }
+
+  /** a set kept in a flat open addressing table, which is reused between the frames:
+   *  clear() only changes the stamp, and entries with an old stamp count as empty
+   */
+  template<class T> struct stamped_set {
+    struct entry { T key; unsigned stamp; };
+    vector<entry> table;
+    unsigned stamp = 1;
+    int qty = 0, shift = 64;
+
+    void clear() {
+      qty = 0;
+      if(++stamp == 0) { for(auto& e: table) e.stamp = 0; stamp = 1; }
+      }
+
+    size_t index(const T& key) const { return (hash_key(key) * 0x9E3779B97F4A7C15ull) >> shift; }
+
+    bool count(const T& key) const {
+      if(table.empty()) return false;
+      size_t mask = table.size() - 1;
+      for(size_t i = index(key);; i = (i+1) & mask) {
+        auto& e = table[i];
+        if(e.stamp != stamp) return false;
+        if(e.key == key) return true;
+        }
+      }
+
+    /** returns false if the key was already in the set */
+    bool insert(const T& key) {
+      if(2 * (qty+1) > isize(table)) grow();
+      size_t mask = table.size() - 1;
+      for(size_t i = index(key);; i = (i+1) & mask) {
+        auto& e = table[i];
+        if(e.stamp != stamp) { e.key = key; e.stamp = stamp; qty++; return true; }
+        if(e.key == key) return false;
+        }
+      }
+
+    void grow() {
+      vector<entry> old;
+      swap(old, table);
+      int bits = max(64 - shift + 1, 8);
+      table.resize(size_t(1) << bits, entry{T(), 0});
+      shift = 64 - bits;
+      qty = 0;
+      for(auto& e: old) if(e.stamp == stamp) insert(e.key);
+      }
+
+    int size() const { return qty; }
+    };
+  #endif
+
+  EX stamped_set<heptagon*> visited;
   EX void enqueue(heptagon *h, const transmatrix& T) {
-    if(!h || visited.count(h)) { return; }
-    visited.insert(h);
+    if(!h || !visited.insert(h)) { return; }
     drawqueue.emplace(h, T, band_shift);
     }  
 
-  EX set<int> visited_by_matrix;
+  EX stamped_set<bucket_key> visited_by_matrix;
   EX void enqueue_by_matrix(heptagon *h, const transmatrix& T) {
     if(!h) return;
-    int b = bucketer(tC0(T));
-    if(visited_by_matrix.count(b)) { return; }
-    visited_by_matrix.insert(b);
+    hyperpoint h0 = tC0(T);
+    if(!visited_by_matrix.insert(bucket_key{bucketer(h0[0]), bucketer(h0[1]), bucketer(h0[2])})) { return; }
     drawqueue.emplace(h, T, band_shift);
     }
   EX }
@@ -89,7 +89,7 @@ bool clockwise(hyperpoint h1, hyperpoint h2) {
 
 EX map<heptagon*, vector<int> > cells_of_heptagon;
 
-int runlevel;
+EX int runlevel;
 vector<ld> edgelens, distlens;
 
 void make_cells_of_heptagon() {
@@ -235,7 +235,7 @@ int rearrange(bool total, ld minedge) {
   return tooshort;
   }
 
-bool step(int delta) {
+EX bool step(int delta) {
 
   if(!gridmaking) return false;
   timetowait = 0;
@@ -535,6 +535,13 @@ EX void compute_geometry() {
     }
   }
 
+/** the largest distance from the heptagon center to the center of its subcell */
+EX ld patch_radius() {
+  ld res = 0;
+  for(auto& p: cells) res = max(res, hdist0(tC0(p.pusher)));
+  return res;
+  }
+
 bool draw_cell_schematics(cell *c, transmatrix V) {
   if(gridmaking) {
     heptagon *h = c->master;
@@ -815,7 +822,7 @@ EX int celldist(cell *c, bool alts) {
 
 eGeometry orig_geometry;
 
-void start_game_on_created_map() {    
+EX void start_game_on_created_map() {    
   popScreen();
   for(hrmap *& hm : allmaps) if(hm == base) hm = NULL;
   stop_game();
@@ -776,6 +776,9 @@ EX namespace models {
     else if(argis("-alpha")) { 
       PHASEFROM(2); shift_arg_formula(vid.alpha);
       }
+    else if(argis("-bench-models")) {
+      PHASE(3); start_game(); shift(); bench_models(argi());
+      }
     else if(argis("-d:model")) 
       launch_dialog(model_menu);
     else if(argis("-d:formula")) {
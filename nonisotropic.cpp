@@ -52,41 +52,338 @@ EX namespace solnihv {
     }
 
   #if HDR
+  /** how the entries of a geodesic table are stored */
+  enum eTableEncoding { teFloat, teHalf };
+
   struct tabled_inverses {
+    /** the size of the grid; for the adaptive tables, the size of the uniform grid resampled for the GPU */
     int PRECX, PRECY, PRECZ;
+    /** the table computed in memory (by devmods/solv-table.cpp) */
     vector<nisot::ptlow> tab;
+    /** the entries in the given encoding, PRECX*PRECY*PRECZ triples (or `entries` for the adaptive tables); points to tab, decoded, or into the mapped file */
+    const void *data;
+    /** adaptive tables: the unit cube is divided into blocks[0] x blocks[1] x blocks[2] blocks; 0 for the uniform tables */
+    int blocks[3];
+    /** adaptive tables: for each block, (o << 4) | l, where the block is a uniform grid of (2^l+1)^3 entries starting at entry o */
+    const unsigned *block_info;
+    /** adaptive tables: block_info of the table computed in memory */
+    vector<unsigned> block_tab;
+    int entries;
+    eTableEncoding encoding;
     string fname;
     bool loaded;
     
     void load();
     hyperpoint get(ld ix, ld iy, ld iz, bool lazy);
+    /** res[i] = get(in[i][0], in[i][1], in[i][2], lazy) for i<n, interpolating SIMD_LANES points at once; in and res may be the same array */
+    void get_batch(const hyperpoint *in, hyperpoint *res, int n, bool lazy);
+    
+    hyperpoint get_adaptive(ld ix, ld iy, ld iz, bool lazy);
     
-    nisot::ptlow& get_int(int ix, int iy, int iz) { return tab[(iz*PRECY+iy)*PRECX+ix]; }
+    nisot::ptlow get_entry(int id);
+    nisot::ptlow get_int(int ix, int iy, int iz) { return get_entry((iz*PRECY+iy)*PRECX+ix); }
+    int entry_count() { return blocks[0] ? entries : PRECX*PRECY*PRECZ; }
+    /** a writable entry of tab, for computing the table */
+    nisot::ptlow& at(int ix, int iy, int iz) { return tab[(iz*PRECY+iy)*PRECX+ix]; }
+    /** use the table computed in tab (and block_tab, if blocks[0]) */
+    void use_tab() { data = &tab[0]; block_info = blocks[0] ? &block_tab[0] : nullptr; entries = isize(tab); encoding = teFloat; loaded = true; toload = true; }
+    void save(const string& fname, eTableEncoding enc, bool compress);
   
     GLuint texture_id;
     bool toload;
     
     GLuint get_texture_id();
   
-    tabled_inverses(string s) : fname(s), texture_id(0), toload(true) {}  
+    tabled_inverses(string s) : data(nullptr), blocks{0, 0, 0}, block_info(nullptr), entries(0), encoding(teFloat), fname(s), loaded(false), texture_id(0), toload(true) {}
+    
+    /** the contents of the file, if it could not be mapped, or the decoded entries of a compressed file */
+    vector<char> decoded;
+    /** the uniform grid resampled from an adaptive table, for the GPU */
+    vector<nisot::ptlow> resampled;
+    void *map = nullptr;
+    size_t map_size = 0;
+    bool read_file(const char*& p, size_t& size);
+    void unmap();
     };
   #endif
   
+  /** the format used by save */
+  EX eTableEncoding save_encoding = teHalf;
+  EX bool save_compressed = false;
+  
+  /* The files start with the header below, followed by the entries. A compressed file has, instead
+   * of the entries, PRECZ+1 offsets (from the start of the file) of the blocks; each block is one
+   * z-slice, encoded independently. Files without the magic are in the original format: the three
+   * sizes followed by the float entries.
+   *
+   * Adaptive tables have version 2, and the header is followed by adaptive_header, block_info,
+   * and the entries (never compressed).
+   */
+  
+  static const int table_version = 1;
+  static const int adaptive_version = 2;
+  
+  struct table_header {
+    char magic[4];
+    int version;
+    int prec[3];
+    int encoding;
+    int compressed;
+    int reserved;
+    };
+  
+  struct adaptive_header {
+    int blocks[3];
+    int entries;
+    };
+  
+  /** IEEE half-precision floats, rounded to nearest */
+  EX unsigned short float_to_half(float f) {
+    unsigned x; memcpy(&x, &f, 4);
+    unsigned sign = (x >> 16) & 0x8000;
+    int e = int((x >> 23) & 0xFF) - 127 + 15;
+    unsigned m = x & 0x7FFFFF;
+    if(((x >> 23) & 0xFF) == 0xFF) return sign | 0x7C00 | (m ? 0x200 : 0);
+    if(e >= 31) return sign | 0x7C00;
+    if(e <= 0) {
+      if(e < -10) return sign;
+      m |= 0x800000;
+      int shift = 14 - e;
+      unsigned h = m >> shift, rem = m & ((1u << shift) - 1), half = 1u << (shift - 1);
+      if(rem > half || (rem == half && (h & 1))) h++;
+      return sign | h;
+      }
+    unsigned h = (e << 10) | (m >> 13), rem = m & 0x1FFF;
+    /* a carry correctly goes into the exponent */
+    if(rem > 0x1000 || (rem == 0x1000 && (h & 1))) h++;
+    return sign | h;
+    }
+  
+  EX float half_to_float(unsigned short h) {
+    /* shifting the exponent and mantissa into place, and multiplying by 2^112, also handles the denormals */
+    unsigned x = unsigned(h & 0x7FFF) << 13;
+    float f;
+    memcpy(&f, &x, 4);
+    f *= 5.192296858534828e33f;
+    memcpy(&x, &f, 4);
+    if((h & 0x7C00) == 0x7C00) x = 0x7F800000 | ((h & 1023) << 13);
+    x |= unsigned(h & 0x8000) << 16;
+    memcpy(&f, &x, 4);
+    return f;
+    }
+  
+  nisot::ptlow tabled_inverses::get_entry(int id) {
+    if(encoding == teHalf) {
+      auto h = (const unsigned short*) data + 3 * id;
+      return nisot::ptlow({half_to_float(h[0]), half_to_float(h[1]), half_to_float(h[2])});
+      }
+    return ((const nisot::ptlow*) data)[id];
+    }
+  
+  int entry_size(eTableEncoding enc) { return enc == teHalf ? 6 : 12; }
+  
+  /** the entries are stored as words of 2 or 4 bytes; a block is the list of the differences between
+   *  each word and its prediction from the entries to the left and above, zigzag and LEB128 encoded
+   */
+  void encode_block(const char *in, int X, int Y, eTableEncoding enc, string& out) {
+    int half = enc == teHalf;
+    auto word = [&] (int x, int y, int c) -> long long {
+      if(x < 0 || y < 0) return 0;
+      int id = (y*X+x)*3+c;
+      if(half) return ((const unsigned short*) in)[id];
+      return ((const int*) in)[id];
+      };
+    for(int y=0; y<Y; y++) for(int x=0; x<X; x++) for(int c=0; c<3; c++) {
+      long long d = word(x, y, c) - (word(x-1, y, c) + word(x, y-1, c) - word(x-1, y-1, c));
+      unsigned long long z = d >= 0 ? 2*d : -2*d-1;
+      while(z >= 128) { out += char(128 | (z & 127)); z >>= 7; }
+      out += char(z);
+      }
+    }
+  
+  bool decode_block(const char *p, const char *end, int X, int Y, eTableEncoding enc, char *out) {
+    int half = enc == teHalf;
+    vector<long long> w(X*Y*3);
+    auto word = [&] (int x, int y, int c) -> long long { return (x < 0 || y < 0) ? 0 : w[(y*X+x)*3+c]; };
+    for(int y=0; y<Y; y++) for(int x=0; x<X; x++) for(int c=0; c<3; c++) {
+      unsigned long long z = 0;
+      for(int s=0;; s+=7) {
+        if(p == end || s > 63) return false;
+        unsigned char b = *(p++);
+        z |= (unsigned long long)(b & 127) << s;
+        if(b < 128) break;
+        }
+      long long d = (z & 1) ? -(long long)(z >> 1) - 1 : (long long)(z >> 1);
+      w[(y*X+x)*3+c] = d + word(x-1, y, c) + word(x, y-1, c) - word(x-1, y-1, c);
+      }
+    for(int i=0; i<X*Y*3; i++) {
+      if(half) ((unsigned short*) out)[i] = (unsigned short) w[i];
+      else ((int*) out)[i] = (int) w[i];
+      }
+    return p == end;
+    }
+  
+  void tabled_inverses::unmap() {
+    #if CAP_MMAP_TABLES
+    if(map) munmap(map, map_size);
+    #endif
+    map = nullptr;
+    }
+  
+  /** map the file (or read it, where mmap is not available); the pages are only read when used */
+  bool tabled_inverses::read_file(const char*& p, size_t& size) {
+    #if CAP_MMAP_TABLES
+    int fd = open(fname.c_str(), O_RDONLY);
+    if(fd < 0) return false;
+    struct stat st;
+    void *m = MAP_FAILED;
+    if(fstat(fd, &st) == 0 && st.st_size > 0)
+      m = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(m == MAP_FAILED) return false;
+    map = m; map_size = st.st_size;
+    p = (const char*) m; size = st.st_size;
+    return true;
+    #else
+    FILE *f = fopen(fname.c_str(), "rb");
+    if(!f) return false;
+    decoded.clear();
+    char buf[65536];
+    while(true) {
+      size_t q = fread(buf, 1, 65536, f);
+      if(q == 0) break;
+      decoded.insert(decoded.end(), buf, buf+q);
+      }
+    fclose(f);
+    p = decoded.data(); size = decoded.size();
+    return size > 0;
+    #endif
+    }
+
   void tabled_inverses::load() {
     if(loaded) return;
-    FILE *f = fopen(fname.c_str(), "rb");
-    // if(!f) f = fopen("/usr/lib/soltable.dat", "rb");
-    if(!f) { addMessage(XLAT("geodesic table missing")); pmodel = mdPerspective; return; }
-    ignore(fread(&PRECX, 4, 1, f));
-    ignore(fread(&PRECY, 4, 1, f));
-    ignore(fread(&PRECZ, 4, 1, f));
-    tab.resize(PRECX * PRECY * PRECZ);
-    ignore(fread(&tab[0], sizeof(nisot::ptlow) * PRECX * PRECY * PRECZ, 1, f));
+    const char *p;
+    size_t size;
+    if(!read_file(p, size)) { addMessage(XLAT("geodesic table missing")); pmodel = mdPerspective; return; }
+    
+    auto fail = [&] {
+      unmap(); decoded.clear();
+      blocks[0] = blocks[1] = blocks[2] = 0; block_info = nullptr;
+      addMessage(XLAT("geodesic table missing")); pmodel = mdPerspective;
+      };
+    
+    table_header hd;
+    bool compressed = false, adaptive = false;
+    size_t start;
+    if(size >= sizeof(hd) && memcmp(p, "HRGT", 4) == 0) {
+      memcpy(&hd, p, sizeof(hd));
+      if((hd.version != table_version && hd.version != adaptive_version) || (hd.encoding != teFloat && hd.encoding != teHalf)) return fail();
+      adaptive = hd.version == adaptive_version;
+      PRECX = hd.prec[0]; PRECY = hd.prec[1]; PRECZ = hd.prec[2];
+      encoding = eTableEncoding(hd.encoding);
+      compressed = hd.compressed;
+      start = sizeof(hd);
+      }
+    else {
+      if(size < 12) return fail();
+      memcpy(&PRECX, p, 4); memcpy(&PRECY, p+4, 4); memcpy(&PRECZ, p+8, 4);
+      encoding = teFloat;
+      start = 12;
+      }
+    if(PRECX < 2 || PRECY < 2 || PRECZ < 2 || PRECX > 4096 || PRECY > 4096 || PRECZ > 4096) return fail();
+    size_t slice = size_t(PRECX) * PRECY * entry_size(encoding);
+    
+    if(adaptive) {
+      adaptive_header ah;
+      if(compressed || size - start < sizeof(ah)) return fail();
+      memcpy(&ah, p + start, sizeof(ah));
+      start += sizeof(ah);
+      for(int d=0; d<3; d++) if(ah.blocks[d] < 1 || ah.blocks[d] > 1024) return fail();
+      size_t nb = size_t(ah.blocks[0]) * ah.blocks[1] * ah.blocks[2];
+      if(ah.entries < 1 || size - start < nb * sizeof(unsigned) || size - start - nb * sizeof(unsigned) < size_t(ah.entries) * entry_size(encoding)) return fail();
+      auto info = (const unsigned*) (p + start);
+      for(size_t b=0; b<nb; b++) {
+        int l = info[b] & 15;
+        size_t s = (1<<l) + 1;
+        if(l > 10 || (info[b] >> 4) + s * s * s > size_t(ah.entries)) return fail();
+        }
+      for(int d=0; d<3; d++) blocks[d] = ah.blocks[d];
+      entries = ah.entries;
+      block_info = info;
+      data = p + start + nb * sizeof(unsigned);
+      }
+    else if(!compressed) {
+      if(size - start < slice * PRECZ) return fail();
+      data = p + start;
+      }
+    else {
+      if(size - start < sizeof(int) * (PRECZ+1)) return fail();
+      vector<int> offsets(PRECZ+1);
+      memcpy(&offsets[0], p + start, sizeof(int) * (PRECZ+1));
+      vector<char> out(slice * PRECZ);
+      for(int z=0; z<PRECZ; z++) {
+        if(offsets[z] < 0 || offsets[z] > offsets[z+1] || size_t(offsets[z+1]) > size) return fail();
+        if(!decode_block(p + offsets[z], p + offsets[z+1], PRECX, PRECY, encoding, &out[slice * z])) return fail();
+        }
+      unmap();
+      decoded = std::move(out);
+      data = decoded.data();
+      }
+    DEBB(DF_GEOM, ("geodesic table ", fname, ": ", PRECX, "x", PRECY, "x", PRECZ, encoding == teHalf ? " half" : " float", compressed ? " compressed" : "",
+      adaptive ? " adaptive, " + its(blocks[0]) + "x" + its(blocks[1]) + "x" + its(blocks[2]) + " blocks, " + its(entries) + " entries" : ""));
+    loaded = true;
+    toload = true;
+    }
+  
+  /** save the table in the given format */
+  void tabled_inverses::save(const string& fname, eTableEncoding enc, bool compress) {
+    bool adaptive = blocks[0];
+    if(adaptive) compress = false;
+    table_header hd;
+    memcpy(hd.magic, "HRGT", 4);
+    hd.version = adaptive ? adaptive_version : table_version;
+    hd.prec[0] = PRECX; hd.prec[1] = PRECY; hd.prec[2] = PRECZ;
+    hd.encoding = enc;
+    hd.compressed = compress;
+    hd.reserved = 0;
+    
+    size_t slice = size_t(PRECX) * PRECY * entry_size(enc);
+    int n = entry_count();
+    vector<char> out(size_t(n) * entry_size(enc));
+    for(int id=0; id<n; id++) {
+      auto v = get_entry(id);
+      if(enc == teHalf) for(int c=0; c<3; c++) ((unsigned short*) &out[0])[3*id+c] = float_to_half(v[c]);
+      else ((nisot::ptlow*) &out[0])[id] = v;
+      }
+    
+    FILE *f = fopen(fname.c_str(), "wb");
+    if(!f) { println(hlog, "cannot write ", fname); return; }
+    fwrite(&hd, sizeof(hd), 1, f);
+    if(adaptive) {
+      adaptive_header ah;
+      for(int d=0; d<3; d++) ah.blocks[d] = blocks[d];
+      ah.entries = n;
+      fwrite(&ah, sizeof(ah), 1, f);
+      fwrite(block_info, sizeof(unsigned), size_t(blocks[0]) * blocks[1] * blocks[2], f);
+      }
+    if(!compress)
+      fwrite(&out[0], out.size(), 1, f);
+    else {
+      vector<string> encoded(PRECZ);
+      vector<int> offsets(PRECZ+1);
+      offsets[0] = sizeof(hd) + sizeof(int) * (PRECZ+1);
+      for(int z=0; z<PRECZ; z++) {
+        encode_block(&out[slice * z], PRECX, PRECY, enc, encoded[z]);
+        offsets[z+1] = offsets[z] + isize(encoded[z]);
+        }
+      fwrite(&offsets[0], sizeof(int) * (PRECZ+1), 1, f);
+      for(auto& b: encoded) fwrite(b.c_str(), b.size(), 1, f);
+      }
     fclose(f);
-    loaded = true;    
     }
   
   hyperpoint tabled_inverses::get(ld ix, ld iy, ld iz, bool lazy) {
+    if(blocks[0]) return get_adaptive(ix, iy, iz, lazy);
     ix *= PRECX-1;
     iy *= PRECY-1;
     iz *= PRECZ-1;
@@ -101,14 +398,19 @@ EX namespace solnihv {
     else {
   
       if(ix >= PRECX-1) ix = PRECX-2;
-      if(iy >= PRECX-1) iy = PRECX-2;
+      if(iy >= PRECY-1) iy = PRECY-2;
       if(iz >= PRECZ-1) iz = PRECZ-2;
       
       int ax = ix, bx = ax+1;
       int ay = iy, by = ay+1;
       int az = iz, bz = az+1;
       
-      #define S0(x,y,z) get_int(x, y, z)[t]
+      /* decode each corner once */
+      nisot::ptlow corner[2][2][2];
+      for(int dx: {0, 1}) for(int dy: {0, 1}) for(int dz: {0, 1})
+        corner[dx][dy][dz] = get_int(ax+dx, ay+dy, az+dz);
+      
+      #define S0(x,y,z) corner[x-ax][y-ay][z-az][t]
       #define S1(x,y) (S0(x,y,az) * (bz-iz) + S0(x,y,bz) * (iz-az))
       #define S2(x) (S1(x,ay) * (by-iy) + S1(x,by) * (iy-ay))
   
@@ -121,6 +423,103 @@ EX namespace solnihv {
     return res;
     }
   
+  /** the block containing the point is found directly; inside the block, the same as get for a uniform table,
+   *  except that the upper edge is interpolated exactly
+   */
+  hyperpoint tabled_inverses::get_adaptive(ld ix, ld iy, ld iz, bool lazy) {
+    ld p[3] = {ix, iy, iz};
+    int b[3];
+    for(int d=0; d<3; d++) {
+      p[d] *= blocks[d];
+      b[d] = p[d];
+      if(b[d] >= blocks[d]) b[d] = blocks[d]-1;
+      if(b[d] < 0) b[d] = 0;
+      p[d] -= b[d];
+      }
+    unsigned info = block_info[(b[2]*blocks[1]+b[1])*blocks[0]+b[0]];
+    int c = 1 << (info & 15), s = c + 1;
+    int a[3];
+    for(int d=0; d<3; d++) {
+      p[d] *= c;
+      a[d] = p[d];
+      if(a[d] >= c) a[d] = c-1;
+      if(a[d] < 0) a[d] = 0;
+      p[d] -= a[d];
+      }
+    int id = (info >> 4) + (a[2]*s + a[1])*s + a[0];
+    
+    hyperpoint res;
+    res[3] = 0;
+    if(lazy) {
+      auto r = get_entry(id);
+      for(int t=0; t<3; t++) res[t] = r[t];
+      return res;
+      }
+    
+    nisot::ptlow corner[8];
+    for(int k=0; k<8; k++) corner[k] = get_entry(id + ((k>>2)&1) * s * s + ((k>>1)&1) * s + (k&1));
+    for(int t=0; t<3; t++) {
+      ld s00 = corner[0][t] * (1-p[0]) + corner[1][t] * p[0], s01 = corner[2][t] * (1-p[0]) + corner[3][t] * p[0];
+      ld s10 = corner[4][t] * (1-p[0]) + corner[5][t] * p[0], s11 = corner[6][t] * (1-p[0]) + corner[7][t] * p[0];
+      res[t] = (s00 * (1-p[1]) + s01 * p[1]) * (1-p[2]) + (s10 * (1-p[1]) + s11 * p[1]) * p[2];
+      }
+    return res;
+    }
+  
+  void tabled_inverses::get_batch(const hyperpoint *in, hyperpoint *res, int n, bool lazy) {
+    if(lazy || blocks[0]) {
+      for(int i=0; i<n; i++) res[i] = get(in[i][0], in[i][1], in[i][2], true);
+      return;
+      }
+    
+    /* the same clamping as in get: a coordinate at the upper edge is interpolated in the last cell but one */
+    simd_ld scx = simd_const(PRECX-1), scy = simd_const(PRECY-1), scz = simd_const(PRECZ-1);
+    simd_ld mx = simd_const(PRECX-2), my = simd_const(PRECY-2), mz = simd_const(PRECZ-2);
+    simd_ld zero = simd_const(0), one = simd_const(1);
+    
+    /* offset[k] is the offset of the corner (k&1, (k>>1)&1, k>>2) */
+    int offset[8];
+    for(int k=0; k<8; k++) offset[k] = ((k>>2)&1) * PRECX * PRECY + ((k>>1)&1) * PRECX + (k&1);
+    
+    simd_batch(in, res, n, [&] (const hyperpoint *a, hyperpoint *out) {
+      simd_ld x, y, z, w;
+      simd_load(a, x, y, z, w);
+      x = simd_max(simd_if_less(x * scx, scx, x * scx, mx), zero);
+      y = simd_max(simd_if_less(y * scy, scy, y * scy, my), zero);
+      z = simd_max(simd_if_less(z * scz, scz, z * scz, mz), zero);
+      
+      ld lx[SIMD_LANES], ly[SIMD_LANES], lz[SIMD_LANES];
+      simd_to_array(x, lx); simd_to_array(y, ly); simd_to_array(z, lz);
+      
+      /* gather the corners lane by lane; the fractional parts replace the coordinates */
+      ld corner[8][3][SIMD_LANES];
+      for(int l=0; l<SIMD_LANES; l++) {
+        int ax = lx[l], ay = ly[l], az = lz[l];
+        lx[l] -= ax; ly[l] -= ay; lz[l] -= az;
+        int id = (az*PRECY+ay)*PRECX+ax;
+        if(encoding == teHalf) {
+          auto h = (const unsigned short*) data;
+          for(int k=0; k<8; k++) for(int t=0; t<3; t++) corner[k][t][l] = half_to_float(h[3*(id+offset[k])+t]);
+          }
+        else {
+          auto p = (const nisot::ptlow*) data;
+          for(int k=0; k<8; k++) for(int t=0; t<3; t++) corner[k][t][l] = p[id+offset[k]][t];
+          }
+        }
+      
+      simd_ld fx = simd_from_array(lx), fy = simd_from_array(ly), fz = simd_from_array(lz);
+      simd_ld gx = one - fx, gy = one - fy, gz = one - fz;
+      simd_ld r[3];
+      for(int t=0; t<3; t++) {
+        auto c = [&] (int k) { return simd_from_array(corner[k][t]); };
+        simd_ld s00 = c(0) * gx + c(1) * fx, s01 = c(2) * gx + c(3) * fx;
+        simd_ld s10 = c(4) * gx + c(5) * fx, s11 = c(6) * gx + c(7) * fx;
+        r[t] = (s00 * gy + s01 * fy) * gz + (s10 * gy + s11 * fy) * fz;
+        }
+      simd_store(out, r[0], r[1], r[2], zero);
+      });
+    }
+  
   GLuint tabled_inverses::get_texture_id() {
     if(!toload) return texture_id;
   
@@ -141,20 +540,27 @@ EX namespace solnihv {
     glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
     
-    auto xbuffer = new glvertex[PRECZ*PRECY*PRECX];
-    
-    for(int z=0; z<PRECZ*PRECY*PRECX; z++) {
-      auto& t = tab[z];
-      xbuffer[z] = glhr::makevertex(t[0], t[1], t[2]);
-      }
-    
+    /* uploaded directly from the buffer used by get_int; the alpha channel is read as 1 */
     #if !ISWEB
-    glTexImage3D(GL_TEXTURE_3D, 0, 34836 /*GL_RGBA32F*/, PRECX, PRECX, PRECZ, 0, GL_RGBA, GL_FLOAT, xbuffer);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+    if(blocks[0]) {
+      /* the shaders use a uniform grid, so the adaptive tables are resampled */
+      resampled.resize(PRECX*PRECY*PRECZ);
+      for(int z=0; z<PRECZ; z++) for(int y=0; y<PRECY; y++) for(int x=0; x<PRECX; x++) {
+        auto h = get(x / (PRECX-1.), y / (PRECY-1.), z / (PRECZ-1.), false);
+        resampled[(z*PRECY+y)*PRECX+x] = nisot::ptlow({float(h[0]), float(h[1]), float(h[2])});
+        }
+      glTexImage3D(GL_TEXTURE_3D, 0, 0x8815 /*GL_RGB32F*/, PRECX, PRECY, PRECZ, 0, GL_RGB, GL_FLOAT, &resampled[0]);
+      }
+    else if(encoding == teHalf)
+      glTexImage3D(GL_TEXTURE_3D, 0, 0x881B /*GL_RGB16F*/, PRECX, PRECY, PRECZ, 0, GL_RGB, 0x140B /*GL_HALF_FLOAT*/, data);
+    else
+      glTexImage3D(GL_TEXTURE_3D, 0, 0x8815 /*GL_RGB32F*/, PRECX, PRECY, PRECZ, 0, GL_RGB, GL_FLOAT, data);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
     #else
     // glTexStorage3D(GL_TEXTURE_3D, 1, 34836 /*GL_RGBA32F*/, PRECX, PRECX, PRECZ);
     // glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, PRECX, PRECY, PRECZ, GL_RGBA, GL_FLOAT, xbuffer);
     #endif
-    delete[] xbuffer;    
     return texture_id;
     }
   
@@ -529,6 +935,37 @@ EX namespace solnihv {
 
     return res;
     }
+  
+  /** get_inverse_exp_symsol or get_inverse_exp_nsym (whichever the geometry uses) for n points, interpolated with get_batch; h and res may be the same array */
+  EX void get_inverse_exp_batch(const hyperpoint *h, hyperpoint *res, int n, bool lazy, bool just_direction) {
+    auto& s = get_tabled();
+    s.load();
+    bool sym = !nih;
+    
+    static vector<hyperpoint> tab;
+    tab.resize(n);
+    for(int i=0; i<n; i++) {
+      ld ix = solnihv::x_to_ix(abs(h[i][0]));
+      ld iy = solnihv::x_to_ix(abs(h[i][1]));
+      ld iz = sym ? tanh(h[i][2]) : (tanh(h[i][2]/4)+1)/2;
+      if(sym && h[i][2] < 0.) { iz = -iz; swap(ix, iy); }
+      tab[i] = point3(ix, iy, iz);
+      }
+    
+    s.get_batch(tab.data(), tab.data(), n, lazy);
+    
+    for(int i=0; i<n; i++) {
+      hyperpoint r = tab[i];
+      if(sym && h[i][2] < 0.) { swap(r[0], r[1]); r[2] = -r[2]; }
+      if(h[i][0] < 0.) r[0] = -r[0];
+      if(h[i][1] < 0.) r[1] = -r[1];
+      if(!just_direction) {
+        ld d = hypot_d(3, r);
+        if(d != 0.) r = r * atanh(d) / d;
+        }
+      res[i] = r;
+      }
+    }
 
   EX string shader_symsol = solnihv::common +
 
@@ -1792,6 +2229,53 @@ EX namespace nisot {
     return at;
     }
 
+  /** numerical_exp of n vectors; in Sol-like geometries, SIMD_LANES geodesics are integrated at once, with the same results */
+  EX void numerical_exp_batch(const hyperpoint *v, hyperpoint *res, int n, int steps) {
+    #if CAP_SOLV
+    if(solnih) {
+      /* christoffel(at, v, v) = (s0 * 2v0v2, s1 * 2v1v2, v0v0 exp(e0 at2) c0 + v1v1 exp(e1 at2) c1) */
+      const ld l2 = log(2), l3 = log(3);
+      ld s0, s1, c0, c1, e0, e1;
+      switch(solnihv::geom()) {
+        case gSol: s0 = -1; s1 = 1; c0 = 1; e0 = 2; c1 = -1; e1 = -2; break;
+        case gSolN: s0 = -l2; s1 = l3; c0 = l2; e0 = 2*l2; c1 = -l3; e1 = -2*l3; break;
+        default: s0 = l2; s1 = l3; c0 = -l2; e0 = -2*l2; c1 = -l3; e1 = -2*l3; break;
+        }
+      simd_ld ks0 = simd_const(s0), ks1 = simd_const(s1), kc0 = simd_const(c0), kc1 = simd_const(c1), ke0 = simd_const(e0), ke1 = simd_const(e1);
+      simd_ld half = simd_const(.5);
+      auto lane_exp = [] (simd_ld x) {
+        ld buf[SIMD_LANES];
+        memcpy(buf, &x, sizeof(x));
+        for(auto& b: buf) b = exp(b);
+        memcpy(&x, buf, sizeof(x));
+        return x;
+        };
+      auto christoffel = [&] (simd_ld at2, simd_ld u0, simd_ld u1, simd_ld u2, simd_ld& r0, simd_ld& r1, simd_ld& r2) {
+        r0 = (u2 * u0 + u0 * u2) * ks0;
+        r1 = (u2 * u1 + u1 * u2) * ks1;
+        r2 = u0 * u0 * lane_exp(ke0 * at2) * kc0 + u1 * u1 * lane_exp(ke1 * at2) * kc1;
+        };
+      simd_batch(v, res, n, [&] (const hyperpoint *in, hyperpoint *out) {
+        hyperpoint w[SIMD_LANES];
+        for(int j=0; j<SIMD_LANES; j++) { w[j] = in[j]; w[j] /= steps; w[j][3] = 0; }
+        simd_ld v0, v1, v2, v3;
+        simd_load(w, v0, v1, v2, v3);
+        simd_ld a0 = simd_const(0), a1 = a0, a2 = a0;
+        for(int i=0; i<steps; i++) {
+          simd_ld k0, k1, k2, m0, m1, m2;
+          christoffel(a2, v0, v1, v2, k0, k1, k2);
+          christoffel(a2 + v2 * half, v0 + k0 * half, v1 + k1 * half, v2 + k2 * half, m0, m1, m2);
+          a0 = a0 + v0 + m0 * half; a1 = a1 + v1 + m1 * half; a2 = a2 + v2 + m2 * half;
+          v0 = v0 + k0; v1 = v1 + k1; v2 = v2 + k2;
+          }
+        simd_store(out, a0, a1, a2, simd_const(1));
+        });
+      return;
+      }
+    #endif
+    for(int i=0; i<n; i++) res[i] = numerical_exp(v[i], steps);
+    }
+
   EX transmatrix parallel_transport_bare(transmatrix Pos, hyperpoint h) {
   
     h[3] = 0;
@@ -1887,6 +2371,21 @@ EX namespace nisot {
       shift(); solnihv::niht.fname = args();
       return 0;
       }
+    else if(argis("-geodesics-format")) {
+      shift(); solnihv::save_encoding = args() == "float" ? solnihv::teFloat : solnihv::teHalf;
+      shift(); solnihv::save_compressed = argi();
+      return 0;
+      }
+    else if(argis("-geodesics-save")) {
+      PHASEFROM(2);
+      start_game();
+      shift();
+      if(!solnih) return 0;
+      auto& t = solnihv::get_tabled();
+      t.load();
+      if(t.loaded) t.save(args(), solnihv::save_encoding, solnihv::save_compressed);
+      return 0;
+      }
     #endif
     else if(argis("-solgeo")) {
       geodesic_movement = true;
@@ -68,6 +68,10 @@ void geometry_information::shift(hpcshape& sh, double dx, double dy, double dz)
     hpc[i] = m * hpc[i];
   }
 
+geometry_information::~geometry_information() {
+  glhr::forget_buffer(ourshape);
+  }
+
 void geometry_information::initPolyForGL() {
 
   ourshape.clear();
@@ -1159,6 +1163,15 @@ void geometry_information::configure_floorshapes() {
   generate_floorshapes();
   }
 
+/** the time spent on the parts of the last prepare_shapes, in ms; the batches of make_3d_models are listed before its total */
+EX vector<pair<string, ld>> shape_build_times;
+
+EX void shape_timing(const string& name, const reaction_t& f) {
+  auto t0 = profile_clock();
+  f();
+  shape_build_times.emplace_back(name, (profile_clock() - t0) / 1e6);
+  }
+
 void geometry_information::prepare_shapes() {
   require_basics();
   #if MAXMDIM >= 4
@@ -1193,18 +1206,32 @@ void geometry_information::prepare_shapes() {
   S36 = SD6 * 6;
   S84 = S42 * 2;
 
+  if(shapecache::load(*this)) return;
+
+  shape_build_times.clear();
+  auto t0 = profile_clock();
+  auto mark = [&] (const string& name) {
+    auto t1 = profile_clock();
+    shape_build_times.emplace_back(name, (t1 - t0) / 1e6);
+    t0 = t1;
+    };
+
   // printf("crossf = %f euclid = %d sphere = %d\n", float(crossf), euclid, sphere);
   hpc.clear();
 
   make_sidewalls();
+  mark("sidewalls");
 
   procedural_shapes();
+  mark("procedural shapes");
 
   #if MAXMDIM >= 4
   create_wall3d();
+  mark("3D walls");
   #endif
 
   configure_floorshapes();
+  mark("floor shapes");
 
   // hand-drawn shapes
 
@@ -1613,14 +1640,20 @@ void geometry_information::prepare_shapes() {
   bshape(shBead1, PPR(20), 1, 251);
   bshape(shArrow, PPR::ARROW, 1, 252);
 
+  mark("hand-drawn shapes");
+
   #if MAXMDIM >= 4
   make_3d_models();
+  mark("3D models");
   #endif
 
   finishshape();
   prehpc = isize(hpc);
 
   initPolyForGL();
+  mark("GL buffers");
+  for(auto& p: shape_build_times) DEBB(DF_POLY, (p.first, ": ", p.second, " ms"));
+  shapecache::save(*this);
   }
 
 EX vector<long double> polydata = {
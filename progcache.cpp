@@ -0,0 +1,179 @@
+// Hyperbolic Rogue -- persistent cache of the compiled shader programs
+// Copyright (C) 2011-2020 Zeno Rogue, see 'hyper.cpp' for details
+
+/** \file progcache.cpp
+ *  \brief save the binaries of the linked GLSL programs on disk, and load them instead of compiling
+ *
+ *  The key of a program consists of the OpenGL vendor, renderer and version strings and the sources
+ *  of both shaders (after add_fixed_functions). The file is named after a hash of the key and contains
+ *  the key itself, so collisions and stale files are detected. A binary which the driver rejects is
+ *  deleted, and the program is compiled from the sources as usual.
+ */
+
+#include "hyper.h"
+namespace hr {
+
+EX namespace progcache {
+
+/** the directory where the program binaries are stored; empty = the cache is off */
+EX string dir;
+
+/** statistics: programs loaded from the cache, programs compiled, and the time spent in both */
+EX int loaded, compiled, rejected;
+EX ld load_ms, compile_ms;
+
+/** increase when the format of the cache files changes */
+const int format_version = 1;
+
+#if CAP_PROGCACHE
+bool supported() {
+  static int result = -1;
+  if(result == -1) {
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    result = formats > 0;
+    DEBB(DF_GRAPH, ("program cache: ", formats, " binary formats"));
+    }
+  return result;
+  }
+
+string key_of(const string& vsh, const string& fsh) {
+  auto str = [] (GLenum e) { auto s = (const char*) glGetString(e); return string(s ? s : "?"); };
+  return "HRPC " + its(format_version) + " " + VER + "; " + str(GL_VENDOR) + "; " + str(GL_RENDERER) + "; " + str(GL_VERSION) + "\n" + vsh + "\n*\n" + fsh;
+  }
+
+string filename_of(const string& key) {
+  /* FNV-1a */
+  unsigned long long h = 14695981039346656037ull;
+  for(char c: key) { h ^= (unsigned char) c; h *= 1099511628211ull; }
+  char buf[32];
+  snprintf(buf, 32, "%016llx", h);
+  return dir + "/" + buf + ".hrpc";
+  }
+
+void read_string(hstream& hs, string& s, int maxlen) {
+  int len = hs.get_raw<int>();
+  if(len < 0 || len > maxlen) throw hstream_exception();
+  s.resize(len);
+  if(len) hs.read_chars(&s[0], len);
+  }
+
+void write_string(hstream& hs, const string& s) {
+  hwrite_raw(hs, isize(s));
+  hs.write_chars(s.c_str(), isize(s));
+  }
+#endif
+
+EX bool available() {
+  #if CAP_PROGCACHE
+  return dir != "" && supported();
+  #else
+  return false;
+  #endif
+  }
+
+/** called before linking the program, so that the driver keeps the binary for save */
+EX void prepare(GLuint program) {
+  #if CAP_PROGCACHE
+  if(available()) glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  #endif
+  }
+
+/** try to load the binary of the program with the given sources; true if it has been loaded and linked successfully */
+EX bool load(GLuint program, const string& vsh, const string& fsh) {
+  #if CAP_PROGCACHE
+  if(!available()) return false;
+  auto t0 = profile_clock();
+  string key = key_of(vsh, fsh);
+  string fname = filename_of(key);
+  string binary;
+  GLenum format;
+  {
+  fhstream f(fname, "rb");
+  if(!f.f) return false;
+  try {
+    string s;
+    read_string(f, s, isize(key));
+    if(s != key) return false;
+    format = f.get_raw<GLenum>();
+    read_string(f, binary, 1<<28);
+    }
+  catch(hstream_exception& e) { return false; }
+  }
+  glProgramBinary(program, format, &binary[0], isize(binary));
+  GLint status = 0;
+  glGetProgramiv(program, GL_LINK_STATUS, &status);
+  if(!status) {
+    /* e.g. the driver has been updated without changing its version string */
+    DEBB(DF_GRAPH, ("program cache: ", fname, " rejected by the driver"));
+    unlink(fname.c_str());
+    rejected++;
+    return false;
+    }
+  loaded++;
+  load_ms += (profile_clock() - t0) / 1e6;
+  return true;
+  #else
+  return false;
+  #endif
+  }
+
+/** save the binary of a program which has just been linked */
+EX void save(GLuint program, const string& vsh, const string& fsh) {
+  #if CAP_PROGCACHE
+  if(!available()) return;
+  GLint len = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &len);
+  if(len <= 0) { DEBB(DF_GRAPH, ("program cache: no binary")); return; }
+  string binary(len, 0);
+  GLenum format;
+  glGetProgramBinary(program, len, &len, &format, &binary[0]);
+  binary.resize(len);
+  string key = key_of(vsh, fsh);
+  string fname = filename_of(key);
+  mkdir(dir.c_str(), 0777);
+  /* write to a temporary file first, so that other instances never see a partial file */
+  string tmpname = fname + "." + its(getpid()) + ".tmp";
+  bool ok = true;
+  {
+  fhstream f(tmpname, "wb");
+  if(!f.f) return;
+  try {
+    write_string(f, key);
+    hwrite_raw(f, format);
+    write_string(f, binary);
+    }
+  catch(hstream_exception& e) { ok = false; }
+  if(fflush(f.f)) ok = false;
+  }
+  if(ok) ok = rename(tmpname.c_str(), fname.c_str()) == 0;
+  if(!ok) {
+    unlink(tmpname.c_str());
+    DEBB(DF_GRAPH, ("program cache: could not save ", fname));
+    }
+  #endif
+  }
+
+EX void print_stats() {
+  println(hlog, "shader programs: ", loaded, " loaded from the cache (", load_ms, " ms), ", compiled, " compiled (", compile_ms, " ms), ", rejected, " rejected");
+  }
+
+#if CAP_COMMANDLINE
+int read_args() {
+  using namespace arg;
+  if(0) ;
+  else if(argis("-progcache")) {
+    shift(); dir = args();
+    }
+  else if(argis("-progcache-stats")) {
+    PHASEFROM(3); print_stats();
+    }
+  else return 1;
+  return 0;
+  }
+
+auto ah = addHook(hooks_args, 0, read_args);
+#endif
+
+EX }
+}
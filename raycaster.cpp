@@ -60,7 +60,7 @@ eGeometry last_geometry;
 /** is the raycaster available? */
 EX bool available() {
   if(noGUI) return false;
-  if(!vid.usingGL) return false;
+  if(cpu ? !cpu_output_available() : !vid.usingGL) return false;
   if(WDIM == 2) return false;
   if(hyperbolic && pmodel == mdPerspective && !penrose)
     return true;
@@ -132,7 +132,7 @@ struct raycaster : glhr::GLprogram {
 
 shared_ptr<raycaster> our_raycaster;
 
-EX void reset_raycaster() { our_raycaster = nullptr; };
+EX void reset_raycaster() { our_raycaster = nullptr; reset_tables(); };
 
 int deg;
 
@@ -761,20 +761,30 @@ void enable_raycaster() {
 
 int length, per_row, rows;
 
-void bind_array(vector<array<float, 4>>& v, GLint t, GLuint& tx, int id) {
-  if(t == -1) println(hlog, "bind to nothing");
-  glUniform1i(t, id);
-
-  if(tx == 0) glGenTextures(1, &tx);
+/** bind the texture tx for v to the unit id; upload all of v if full, or just the given spans (row, first column, last column + 1) */
+void upload_array(vector<array<float, 4>>& v, GLuint& tx, int id, bool full, const vector<array<int, 3>>& spans) {
+  if(tx == 0) { glGenTextures(1, &tx); full = true; }
 
   glActiveTexture(GL_TEXTURE0 + id);
   glBindTexture(GL_TEXTURE_2D, tx);
 
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  
-  glTexImage2D(GL_TEXTURE_2D, 0, 0x8814 /* GL_RGBA32F */, length, isize(v)/length, 0, GL_RGBA, GL_FLOAT, &v[0]);  
-  GLERR("bind_array");
+  if(full) {
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, 0x8814 /* GL_RGBA32F */, length, isize(v)/length, 0, GL_RGBA, GL_FLOAT, &v[0]);  
+    tables_upload_bytes += isize(v) * sizeof(v[0]);
+    }
+  else for(auto& sp: spans) {
+    glTexSubImage2D(GL_TEXTURE_2D, 0, sp[1], sp[0], sp[2] - sp[1], 1, GL_RGBA, GL_FLOAT, &v[sp[0] * length + sp[1]]);
+    tables_upload_bytes += (sp[2] - sp[1]) * sizeof(v[0]);
+    }
+  GLERR("upload_array");
+  }
+
+void bind_array(vector<array<float, 4>>& v, GLint t, GLuint& tx, int id, bool full, const vector<array<int, 3>>& spans) {
+  if(t == -1) println(hlog, "bind to nothing");
+  glUniform1i(t, id);
+  upload_array(v, tx, id, full, spans);
   }
 
 void uniform2(GLint id, array<float, 2> fl) {
@@ -790,42 +800,171 @@ array<float, 2> enc(int i, int a) {
 
 color_t color_out_of_range = 0xFF0080FF;
 
-EX void cast() {
-  enable_raycaster();
-  
-  if(comparison_mode) 
-    glColorMask( GL_TRUE,GL_FALSE,GL_FALSE,GL_TRUE );
+/** keep the cell tables between frames, and only update the cells which have changed */
+EX bool persistent_tables = true;
 
-  auto& o = our_raycaster;
-  
-  vector<glvertex> screen = {
-    glhr::makevertex(-1, -1, 1),
-    glhr::makevertex(-1, +1, 1),
-    glhr::makevertex(+1, -1, 1),
-    glhr::makevertex(-1, +1, 1),
-    glhr::makevertex(+1, -1, 1),
-    glhr::makevertex(+1, +1, 1)
-    };
+/** statistics of the last frame: time spent updating the tables, bytes uploaded, cells refilled */
+EX ld tables_ms;
+EX int tables_upload_bytes, tables_refilled;
 
-  ld d = current_display->eyewidth();
-  if(vid.stereo_mode == sLR) d = 2 * d - 1;
-  else d = -d;
+#if HDR
+/** the cells seen by the raycaster, and their walls; indexed by id * deg + direction
+ *  The ids are kept between frames: cells which leave the view free their ids, and cells which enter take free ids.
+ */
+struct cell_tables {
+  /** the cells, by their ids; nullptr if the id is free */
+  vector<cell*> lst;
+  /** the id of the cell containing the camera */
+  int start_id;
+  /** the position of the camera, relative to lst[start_id] */
+  transmatrix start;
+  /** the matrices to go through a wall; conn_matrix are indices to this */
+  vector<transmatrix> ms;
+  /** the id of the adjacent cell, or -1 if it is out of range */
+  vector<int> conn_cell;
+  vector<int> conn_matrix;
+  vector<glvertex> wallcolor, texturemap;
+  /** changes whenever the tables are built from scratch */
+  int generation;
+  /** the ids whose entries have changed since the last upload */
+  vector<int> dirty;
+  vector<char> is_dirty;
+  };
+#endif
 
-  glUniform1f(o->uShift, -global_projection * d);
-  
-  auto& cd = current_display;
-  cd->set_viewport(global_projection);
-  cd->set_mask(global_projection);
-  glUniform1f(o->uFovX, cd->tanfov / (vid.stereo_mode == sLR ? 2 : 1));
-  glUniform1f(o->uFovY, cd->tanfov * cd->ysize / cd->xsize);
+EX cell_tables tables;
+
+/** everything used in the tables which is not checked per cell; the tables are rebuilt when it changes */
+struct tables_key {
+  eGeometry geo;
+  int deg, max_cells, fixed_matrices;
+  bool rays_generate, racing, textured;
+  color_t out_of_range;
+  bool operator == (const tables_key& k) const {
+    return geo == k.geo && deg == k.deg && max_cells == k.max_cells && fixed_matrices == k.fixed_matrices &&
+      rays_generate == k.rays_generate && racing == k.racing && textured == k.textured && out_of_range == k.out_of_range;
+    }
+  };
+
+tables_key last_key;
+bool tables_valid;
+cell *tables_center;
+vector<int> free_ids;
+/** the state of each cell when its entries were computed */
+vector<unsigned> signatures;
+
+/** the state of a cell which its entries, and the entries of its neighbors, depend on */
+unsigned cell_signature(cell *c) {
+  unsigned h = c->wall;
+  h = h * 0x9E3779B1 + c->land;
+  h = h * 0x9E3779B1 + c->wparam;
+  h = h * 0x9E3779B1 + c->landparam;
+  return h;
+  }
+
+/** forget the tables; they will be built from scratch in the next frame */
+EX void reset_tables() {
+  tables_valid = false;
+  tables_center = nullptr;
+  }
+
+auto ah_tables = addHook(clearmemory, 0, reset_tables) + addHook(hooks_removecells, 0, [] {
+  for(cell *c: tables.lst) if(c && is_cell_removed(c)) { reset_tables(); return; }
+  });
+
+void mark_dirty(cell_tables& t, int id) {
+  if(t.is_dirty[id]) return;
+  t.is_dirty[id] = true;
+  t.dirty.push_back(id);
+  }
+
+/** the matrices which do not depend on the cells: uM[which] for each direction, and the reflections */
+vector<transmatrix> fixed_matrices() {
+  vector<transmatrix> ms;
+  for(int j=0; j<S7; j++) ms.push_back(currentmap->iadj(cwt.at, j));
+  if(prod) ms.push_back(Id);
+  if(prod) ms.push_back(Id);
   
+  if(!sol && !nil && reflect_val) {
+    for(int j=0; j<S7; j++) {
+      transmatrix T = inverse(ms[j]);
+      hyperpoint h = tC0(T);
+      ld d = hdist0(h);
+      transmatrix U = rspintox(h) * xpush(d/2) * MirrorX * xpush(-d/2) * spintox(h);
+      ms.push_back(U);
+      }
+    }
+  return ms;
+  }
+
+/** compute the entries of the cell c with the given id; cl lists the cells in the view, and id_of gives their ids */
+void fill_cell(cell_tables& t, manual_celllister& cl, const vector<int>& id_of, cell *c, int id) {
+  auto& ms = t.ms;
+  for(int i=0; i<deg; i++) {
+    int u = id * deg + i;
+    t.conn_cell[u] = -1;
+    t.conn_matrix[u] = 0;
+    t.wallcolor[u] = glhr::acolor(0);
+    t.texturemap[u] = glhr::makevertex(0,0,0);
+    }
+  forCellIdEx(c1, i, c) { 
+    int u = id * deg + i;
+    if(!cl.listed(c1)) {
+      t.wallcolor[u] = glhr::acolor(color_out_of_range | 0xFF);
+      t.texturemap[u] = glhr::makevertex(0.1,0,0);
+      continue;
+      }
+    t.conn_cell[u] = id_of[c1->listindex];
+    if(isWall3(c1)) {
+      celldrawer dd;
+      dd.cw.at = c1;
+      dd.setcolors();
+      transmatrix Vf;
+      dd.set_land_floor(Vf);
+      color_t wcol = darkena(dd.wcol, 0, 0xFF);
+      int dv = get_darkval(c1, c->c.spin(i));
+      float p = 1 - dv / 16.;
+      t.wallcolor[u] = glhr::acolor(wcol);
+      for(int a: {0,1,2}) t.wallcolor[u][a] *= p;
+      if(qfi.fshape && qfi.fshape->id < isize(floor_texture_map)) {
+        t.texturemap[u] = floor_texture_map[qfi.fshape->id];
+        }
+      else
+        t.texturemap[u] = glhr::makevertex(0.1,0,0);
+      }
+    else {
+      color_t col = transcolor(c, c1, winf[c->wall].color) | transcolor(c1, c, winf[c1->wall].color);
+      if(col == 0)
+        t.wallcolor[u] = glhr::acolor(0);
+      else {
+        int dv = get_darkval(c1, c->c.spin(i));
+        float p = 1 - dv / 16.;
+        t.wallcolor[u] = glhr::acolor(col);
+        for(int a: {0,1,2}) t.wallcolor[u][a] *= p;
+        t.texturemap[u] = glhr::makevertex(0.001,0,0);
+        }
+      }
+    
+    if(prod && i >= S7) {
+      t.conn_matrix[u] = S7;
+      continue;
+      }
+    transmatrix T = currentmap->iadj(c, i) * inverse(ms[i]);
+    for(int k=0; k<=isize(ms); k++) {
+      if(k < isize(ms) && !eqmatrix(ms[k], T)) continue;
+      if(k == isize(ms)) ms.push_back(T);
+      t.conn_matrix[u] = k;
+      break;
+      }
+    }
+  }
+
+/** update the tables for the current view, and return them */
+EX cell_tables& update_tables() {
+  auto t0 = profile_clock();
+  auto& t = tables;
   deg = S7;
   if(prod) deg += 2;
-  
-  length = 4096;
-  per_row = length / deg;
-  
-  vector<cell*> lst;
 
   cell *cs = centerover;
 
@@ -838,8 +977,32 @@ EX void cast() {
   T = inverse(T);
 
   virtualRebase(cs, T);
-  
-  if(true) {
+  t.start = T;
+
+  auto fixed = fixed_matrices();
+  tables_key key = {geometry, deg, max_cells, isize(fixed), rays_generate, racing::on, !floor_texture_map.empty(), color_out_of_range};
+  bool reset = !tables_valid || !persistent_tables || !(key == last_key);
+  if(!reset) for(int i=0; i<isize(fixed); i++) if(!eqmatrix(fixed[i], t.ms[i])) reset = true;
+
+  if(reset) {
+    t.lst.clear();
+    t.ms = fixed;
+    t.conn_cell.clear(); t.conn_matrix.clear(); t.wallcolor.clear(); t.texturemap.clear();
+    t.dirty.clear(); t.is_dirty.clear();
+    t.generation++;
+    free_ids.clear();
+    signatures.clear();
+    tables_center = nullptr;
+    last_key = key;
+    tables_valid = true;
+    }
+
+  tables_refilled = 0;
+  bool changed = cs != tables_center;
+  if(!changed) for(int id=0; id<isize(t.lst); id++)
+    if(t.lst[id] && cell_signature(t.lst[id]) != signatures[id]) { changed = true; break; }
+
+  if(changed) {
     manual_celllister cl;
     cl.add(cs);
     bool optimize = !isWall3(cs);
@@ -854,99 +1017,152 @@ EX void cast() {
         }
       }
     finish:
-    lst = cl.lst;
+
+    /* the ids of the listed cells; cells whose entries need to be computed again */
+    vector<int> id_of(isize(cl.lst), -1);
+    vector<char> refill(isize(cl.lst), false);
+    auto refill_around = [&] (cell *c) {
+      if(cl.listed(c)) refill[c->listindex] = true;
+      forCellEx(c2, c) if(cl.listed(c2)) refill[c2->listindex] = true;
+      };
+
+    for(int id=0; id<isize(t.lst); id++) {
+      cell *c = t.lst[id];
+      if(!c) continue;
+      if(!cl.listed(c)) {
+        /* the neighbors now see this cell as out of range */
+        refill_around(c);
+        t.lst[id] = nullptr;
+        free_ids.push_back(id);
+        continue;
+        }
+      id_of[c->listindex] = id;
+      if(cell_signature(c) != signatures[id]) refill_around(c);
+      }
+
+    for(int i=0; i<isize(cl.lst); i++) if(id_of[i] == -1) {
+      int id;
+      if(free_ids.empty()) {
+        id = isize(t.lst);
+        t.lst.push_back(nullptr);
+        signatures.push_back(0);
+        t.is_dirty.push_back(false);
+        for(auto v: {&t.conn_cell, &t.conn_matrix}) v->resize(isize(t.lst) * deg, -1);
+        for(auto v: {&t.wallcolor, &t.texturemap}) v->resize(isize(t.lst) * deg, glhr::makevertex(0, 0, 0));
+        }
+      else {
+        id = free_ids.back();
+        free_ids.pop_back();
+        }
+      t.lst[id] = cl.lst[i];
+      id_of[i] = id;
+      refill_around(cl.lst[i]);
+      }
+
+    for(int ci=0; ci<isize(cl.lst); ci++) if(refill[ci]) {
+      int id = id_of[ci];
+      signatures[id] = cell_signature(cl.lst[ci]);
+      mark_dirty(t, id);
+      tables_refilled++;
+      fill_cell(t, cl, id_of, cl.lst[ci], id);
+      }
+
+    tables_center = cs;
+    t.start_id = id_of[0];
     }
+
+  tables_ms = (profile_clock() - t0) / 1e6;
+  return t;
+  }
+
+/** the tables in the layout of the GLSL program, i.e., each row of the texture has per_row cells */
+vector<array<float, 4>> gpu_connections, gpu_wallcolor, gpu_texturemap;
+int gpu_generation = -1;
+
+/** move the changed entries of the tables to the GPU layout; returns the spans (row, first column, last column + 1) to upload, or sets full */
+vector<array<int, 3>> gpu_layout(cell_tables& t, bool& full) {
+  vector<array<int, 3>> spans;
+  full = t.generation != gpu_generation;
+  if(full) {
+    gpu_generation = t.generation;
+    length = 4096;
+    per_row = length / deg;
+    rows = next_p2((max_cells+per_row-1) / per_row);
+    for(auto v: {&gpu_connections, &gpu_wallcolor, &gpu_texturemap}) {
+      v->clear(); v->resize(length * rows);
+      }
+    for(int id=0; id<isize(t.lst); id++) mark_dirty(t, id);
+    }
+  sort(t.dirty.begin(), t.dirty.end());
+  for(int id: t.dirty) {
+    t.is_dirty[id] = false;
+    int row = id / per_row, x0 = id % per_row * deg;
+    if(!spans.empty() && spans.back()[0] == row && spans.back()[2] == x0) spans.back()[2] = x0 + deg;
+    else spans.push_back({row, x0, x0 + deg});
+    for(int i=0; i<deg; i++) {
+      int u = row * length + x0 + i;
+      int v = id * deg + i;
+      gpu_wallcolor[u] = t.wallcolor[v];
+      gpu_texturemap[u] = t.texturemap[v];
+      auto& conn = gpu_connections[u];
+      if(t.conn_cell[v] < 0) { conn = glhr::makevertex(0, 0, 0); conn[3] = 0; continue; }
+      auto code = enc(t.conn_cell[v], 0);
+      conn[0] = code[0];
+      conn[1] = code[1];
+      conn[2] = (t.conn_matrix[v]+.5) / 1024.;
+      conn[3] = 0;
+      }
+    }
+  t.dirty.clear();
+  return spans;
+  }
+
+EX void cast() {
+  if(cpu) { cast_cpu(); return; }
+  enable_raycaster();
   
-  rows = next_p2((isize(lst)+per_row-1) / per_row);
+  if(comparison_mode) 
+    glColorMask( GL_TRUE,GL_FALSE,GL_FALSE,GL_TRUE );
+
+  auto& o = our_raycaster;
   
-  map<cell*, int> ids;
-  for(int i=0; i<isize(lst); i++) ids[lst[i]] = i;
+  vector<glvertex> screen = {
+    glhr::makevertex(-1, -1, 1),
+    glhr::makevertex(-1, +1, 1),
+    glhr::makevertex(+1, -1, 1),
+    glhr::makevertex(-1, +1, 1),
+    glhr::makevertex(+1, -1, 1),
+    glhr::makevertex(+1, +1, 1)
+    };
 
+  ld d = current_display->eyewidth();
+  if(vid.stereo_mode == sLR) d = 2 * d - 1;
+  else d = -d;
+
+  glUniform1f(o->uShift, -global_projection * d);
+  
+  auto& cd = current_display;
+  cd->set_viewport(global_projection);
+  cd->set_mask(global_projection);
+  glUniform1f(o->uFovX, cd->tanfov / (vid.stereo_mode == sLR ? 2 : 1));
+  glUniform1f(o->uFovY, cd->tanfov * cd->ysize / cd->xsize);
+  
+  auto& t = update_tables();
+  bool full;
+  auto spans = gpu_layout(t, full);
+  
   glUniform1i(o->uLength, length);
   GLERR("uniform mediump length");
   
-  glUniformMatrix4fv(o->uStart, 1, 0, glhr::tmtogl_transpose3(T).as_array());
+  glUniformMatrix4fv(o->uStart, 1, 0, glhr::tmtogl_transpose3(t.start).as_array());
   if(o->uLP != -1) glUniformMatrix4fv(o->uLP, 1, 0, glhr::tmtogl_transpose3(inverse(NLP)).as_array());
   GLERR("uniform mediump start");
-  uniform2(o->uStartid, enc(ids[cs], 0));
+  uniform2(o->uStartid, enc(t.start_id, 0));
   GLERR("uniform mediump startid");
   glUniform1f(o->uIPD, vid.ipd);
   GLERR("uniform mediump IPD");
   
-  vector<transmatrix> ms;
-  for(int j=0; j<S7; j++) ms.push_back(currentmap->iadj(cwt.at, j));
-  if(prod) ms.push_back(Id);
-  if(prod) ms.push_back(Id);
-  
-  if(!sol && !nil && reflect_val) {
-    for(int j=0; j<S7; j++) {
-      transmatrix T = inverse(ms[j]);
-      hyperpoint h = tC0(T);
-      ld d = hdist0(h);
-      transmatrix U = rspintox(h) * xpush(d/2) * MirrorX * xpush(-d/2) * spintox(h);
-      ms.push_back(U);
-      }
-    }
-  
-  vector<array<float, 4>> connections(length * rows);
-  vector<array<float, 4>> wallcolor(length * rows);
-  vector<array<float, 4>> texturemap(length * rows);
-
-  if(1) for(cell *c: lst) {
-    int id = ids[c];
-    forCellIdEx(c1, i, c) { 
-      int u = (id/per_row*length) + (id%per_row * deg) + i;
-      if(!ids.count(c1)) {
-        wallcolor[u] = glhr::acolor(color_out_of_range | 0xFF);
-        texturemap[u] = glhr::makevertex(0.1,0,0);
-        continue;
-        }
-      auto code = enc(ids[c1], 0);
-      connections[u][0] = code[0];
-      connections[u][1] = code[1];
-      if(isWall3(c1)) {
-        celldrawer dd;
-        dd.cw.at = c1;
-        dd.setcolors();
-        transmatrix Vf;
-        dd.set_land_floor(Vf);
-        color_t wcol = darkena(dd.wcol, 0, 0xFF);
-        int dv = get_darkval(c1, c->c.spin(i));
-        float p = 1 - dv / 16.;
-        wallcolor[u] = glhr::acolor(wcol);
-        for(int a: {0,1,2}) wallcolor[u][a] *= p;
-        if(qfi.fshape) {
-          texturemap[u] = floor_texture_map[qfi.fshape->id];
-          }
-        else
-          texturemap[u] = glhr::makevertex(0.1,0,0);
-        }
-      else {
-        color_t col = transcolor(c, c1, winf[c->wall].color) | transcolor(c1, c, winf[c1->wall].color);
-        if(col == 0)
-          wallcolor[u] = glhr::acolor(0);
-        else {
-          int dv = get_darkval(c1, c->c.spin(i));
-          float p = 1 - dv / 16.;
-          wallcolor[u] = glhr::acolor(col);
-          for(int a: {0,1,2}) wallcolor[u][a] *= p;
-          texturemap[u] = glhr::makevertex(0.001,0,0);
-          }
-        }
-      
-      if(prod && i >= S7) {
-        connections[u][2] = (S7+.5) / 1024.;
-        continue;
-        }
-      transmatrix T = currentmap->iadj(c, i) * inverse(ms[i]);
-      for(int k=0; k<=isize(ms); k++) {
-        if(k < isize(ms) && !eqmatrix(ms[k], T)) continue;
-        if(k == isize(ms)) ms.push_back(T);
-        connections[u][2] = (k+.5) / 1024.;
-        break;
-        }
-      }
-    }
+  auto& ms = t.ms;
 
   vector<GLint> wallstart;
   for(auto i: cgi.wallstart) wallstart.push_back(i);
@@ -988,9 +1204,11 @@ EX void cast() {
   for(auto& m: ms) gms.push_back(glhr::tmtogl_transpose3(m));
   glUniformMatrix4fv(o->uM, isize(gms), 0, gms[0].as_array());
 
-  bind_array(wallcolor, o->tWallcolor, txWallcolor, 4);
-  bind_array(connections, o->tConnections, txConnections, 3);
-  bind_array(texturemap, o->tTextureMap, txTextureMap, 5);
+  tables_upload_bytes = 0;
+  bind_array(gpu_wallcolor, o->tWallcolor, txWallcolor, 4, full, spans);
+  bind_array(gpu_connections, o->tConnections, txConnections, 3, full, spans);
+  bind_array(gpu_texturemap, o->tTextureMap, txTextureMap, 5, full, spans);
+  DEBB(DF_GRAPH, ("raycaster tables: ", tables_refilled, " cells refilled in ", tables_ms, " ms, ", tables_upload_bytes, " bytes uploaded"));
   
   auto cols = glhr::acolor(darkena(backcolor, 0, 0xFF));
   glUniform4f(o->uFogColor, cols[0], cols[1], cols[2], cols[3]);
@@ -1011,6 +1229,55 @@ EX void cast() {
   GLERR("finish");
   }
 
+/** move the camera through the map for the given number of frames, and compare the cost of the tables with and without persistent_tables */
+EX void tables_benchmark(int frames) {
+  println(hlog, format("%-22s %10s %10s %10s %12s %10s", "tables", "update ms", "layout ms", "upload ms", "bytes", "refilled"));
+  for(int persistent: {0, 1}) {
+    dynamicval<bool> dp(persistent_tables, persistent);
+    dynamicval<cell*> dc(centerover, centerover);
+    dynamicval<transmatrix> dv(View, Id);
+    dynamicval<transmatrix> da(actual_view_transform, Id);
+    reset_tables();
+    gpu_generation = -1;
+    std::mt19937 gen(1);
+    ld update_ms = 0, layout_ms = 0, upload_ms = 0;
+    long long bytes = 0, refilled = 0;
+    for(int i=0; i<frames; i++) {
+      /* move to a random adjacent cell every fourth frame */
+      if(i % 4 == 3) {
+        int d = gen() % centerover->type;
+        cell *c2 = centerover->cmove(d);
+        if(!isWall3(c2)) { centerover = c2; View = Id; }
+        }
+      auto& t = update_tables();
+      update_ms += tables_ms;
+      refilled += tables_refilled;
+      auto t0 = profile_clock();
+      bool full;
+      auto spans = gpu_layout(t, full);
+      auto t1 = profile_clock();
+      layout_ms += (t1 - t0) / 1e6;
+      tables_upload_bytes = 0;
+      if(vid.usingGL) {
+        upload_array(gpu_wallcolor, txWallcolor, 4, full, spans);
+        upload_array(gpu_connections, txConnections, 3, full, spans);
+        upload_array(gpu_texturemap, txTextureMap, 5, full, spans);
+        glFinish();
+        }
+      else {
+        int q = 0;
+        for(auto& sp: spans) q += sp[2] - sp[1];
+        tables_upload_bytes = 3 * (full ? isize(gpu_wallcolor) : q) * sizeof(gpu_wallcolor[0]);
+        }
+      upload_ms += (profile_clock() - t1) / 1e6;
+      bytes += tables_upload_bytes;
+      }
+    println(hlog, format("%-22s %10.3f %10.3f %10.3f %12lld %10.1f", persistent ? "persistent" : "rebuilt every frame",
+      double(update_ms / frames), double(layout_ms / frames), double(upload_ms / frames), bytes / frames, refilled * 1. / frames));
+    }
+  reset_tables();
+  }
+
 EX void configure() {
   cmode = sm::SIDE | sm::MAYDARK;
   gamescreen(0);
@@ -1140,6 +1407,12 @@ int readArgs() {
     PHASEFROM(2); 
     shift_arg_formula(reflect_val);
     }
+  else if(argis("-ray-persistent")) {
+    PHASEFROM(2); shift(); persistent_tables = argi();
+    }
+  else if(argis("-ray-tables-bench")) {
+    PHASE(3); start_game(); shift(); tables_benchmark(argi());
+    }
   else if(argis("-ray-cells-no")) {
     PHASEFROM(2); shift();
     rays_generate = false;
@@ -0,0 +1,926 @@
+// Hyperbolic Rogue -- raycaster on the CPU
+// Copyright (C) 2011-2020 Zeno Rogue, see 'hyper.cpp' for details
+
+/** \file raycpu.cpp
+ *  \brief the raycaster from raycaster.cpp, run on the CPU
+ *
+ *  The rays are traced exactly as in the GLSL program built by enable_raycaster, step by step and from
+ *  the same cell tables (update_tables), but in double precision. This works without OpenGL (the result is
+ *  drawn into the SDL surface), and serves as the reference for the GPU raycaster.
+ *
+ *  Pixel rows are distributed among threads, and each row is traced in packets of SIMD_LANES rays,
+ *  which make their steps together. In hyperbolic and Euclidean geometries, the wall matrices do not
+ *  depend on the cell, so the walls hit by all the rays of a packet are found in one SIMD pass.
+ */
+
+#include "hyper.h"
+#if CAP_THREAD
+#include <thread>
+#include <atomic>
+#endif
+
+namespace hr {
+
+EX namespace ray {
+
+#if MAXMDIM >= 4
+
+/** trace the rays on the CPU instead of using the GLSL program */
+EX bool cpu = false;
+
+/** the number of threads used by the CPU raycaster; 0 = one per hardware thread */
+EX int cpu_threads = 0;
+
+/** find the walls hit by the rays of a packet together, in the geometries where it is possible */
+EX bool cpu_simd = true;
+
+/** statistics of the last frame traced on the CPU */
+EX int cpu_rays;
+EX ld cpu_ms;
+
+/** everything the rays need, computed once per frame */
+struct cpu_context {
+  cell_tables *t;
+  int max_iter;
+  int flat1, flat2;
+  bool use_reflect, asonov, simd_walls, textured;
+  ld maxstep, minstep;
+  transmatrix LP, straighten;
+  hyperpoint reflectx, reflecty;
+  vector<int> wallstart;
+  vector<hyperpoint> wallx, wally;
+  ld plevel, blevel, binary_width;
+  ld linear_sight_range, exp_start, exp_decay;
+  glvertex fog;
+  ld fovx, fovy, shift;
+  ld vnear, vfar;
+  };
+
+/** the state of a single ray; the fields correspond to the variables of the GLSL program */
+struct ray_state {
+  hyperpoint at0, position, tangent;
+  ld go, left, next;
+  ld zpos, zspeed, xspeed;
+  int cid;
+  bool active, depthtoset;
+  ld col[3];
+  float depth;
+  };
+
+/** a copy of the floor texture, read from the GPU */
+struct texture_copy {
+  GLuint id;
+  int tx, ty;
+  vector<color_t> data;
+  };
+
+texture_copy texcopy;
+
+/** make sure that texcopy is a copy of floor_textures; false if there is no texture to read */
+bool read_texture() {
+  #if CAP_GL
+  if(!floor_textures || !vid.usingGL || !floor_textures->FramebufferName) return false;
+  if(texcopy.id == floor_textures->renderedTexture && !texcopy.data.empty()) return true;
+  auto& ft = *floor_textures;
+  texcopy.id = ft.renderedTexture;
+  texcopy.tx = ft.tx; texcopy.ty = ft.ty;
+  texcopy.data.assign(ft.tx * ft.ty, 0);
+  resetbuffer rb;
+  glBindFramebuffer(GL_FRAMEBUFFER, ft.FramebufferName);
+  glReadPixels(0, 0, ft.tx, ft.ty, GL_BGRA, GL_UNSIGNED_BYTE, &texcopy.data[0]);
+  rb.reset();
+  GLERR("read_texture");
+  return true;
+  #else
+  return false;
+  #endif
+  }
+
+/** bilinear filtering with GL_REPEAT, as texture2D does */
+array<ld, 3> sample_texture(ld s, ld t) {
+  auto& tc = texcopy;
+  ld x = s * tc.tx - .5, y = t * tc.ty - .5;
+  ld fx = floor(x), fy = floor(y);
+  int ix = int(fx), iy = int(fy);
+  fx = x - fx; fy = y - fy;
+  auto wrap = [] (int i, int n) { i %= n; return i < 0 ? i + n : i; };
+  int x0 = wrap(ix, tc.tx), x1 = wrap(ix+1, tc.tx);
+  int y0 = wrap(iy, tc.ty), y1 = wrap(iy+1, tc.ty);
+  array<ld, 3> res;
+  for(int p=0; p<3; p++) {
+    auto val = [&] (int x, int y) { return part(tc.data[y * tc.tx + x], 2-p) / 255.; };
+    res[p] =
+      (val(x0, y0) * (1-fx) + val(x1, y0) * fx) * (1-fy) +
+      (val(x0, y1) * (1-fx) + val(x1, y1) * fx) * fy;
+    }
+  return res;
+  }
+
+void setup_context(cpu_context& cx) {
+  cx.t = &update_tables();
+
+  cx.max_iter = max_iter_current();
+  cx.asonov = hr::asonov::in();
+  cx.use_reflect = reflect_val && !nil && !levellines;
+  cx.flat1 = 0; cx.flat2 = S7;
+  if(hyperbolic && binarytiling) {
+    cx.flat1 = binary::dirs_outer();
+    cx.flat2 -= binary::dirs_inner();
+    }
+  cx.simd_walls = cpu_simd && !nonisotropic && !prod && !binarytiling && (hyperbolic || euclid);
+  cx.textured = !(levellines && disable_texture) && read_texture();
+  cx.maxstep = nonisotropic ? maxstep_current() : 0;
+  cx.minstep = minstep;
+  cx.LP = prod ? inverse(NLP) : Id;
+  cx.straighten = cx.asonov ? asonov::straighten : Id;
+  if(cx.asonov) {
+    cx.reflectx = tangent_length(spin(90*degree) * asonov::ty, 2);
+    cx.reflecty = tangent_length(spin(90*degree) * asonov::tx, 2);
+    }
+
+  cx.wallstart.clear();
+  for(auto i: cgi.wallstart) cx.wallstart.push_back(i);
+  cx.wallx.clear(); cx.wally.clear();
+  for(auto& m: cgi.raywall) {
+    cx.wallx.push_back(m[0]);
+    cx.wally.push_back(m[1]);
+    }
+
+  cx.plevel = prod ? cgi.plevel / 2 : 0;
+  cx.blevel = (hyperbolic && binarytiling) ? log(binary::expansion()) / 2 : 0;
+  cx.binary_width = vid.binary_width/2 * (nih?1:log(2));
+  cx.linear_sight_range = sightranges[geometry];
+  cx.exp_start = exp_start;
+  cx.exp_decay = exp_decay_current();
+  cx.fog = glhr::acolor(darkena(backcolor, 0, 0xFF));
+
+  auto& cd = current_display;
+  ld d = cd->eyewidth();
+  if(vid.stereo_mode == sLR) d = 2 * d - 1;
+  else d = -d;
+  cx.shift = -global_projection * d;
+  cx.fovx = cd->tanfov / (vid.stereo_mode == sLR ? 2 : 1);
+  cx.fovy = cd->tanfov * cd->ysize / cd->xsize;
+  cx.vnear = glhr::vnear_default;
+  cx.vfar = glhr::vfar_default;
+  }
+
+inline ld dot4(const hyperpoint& a, const hyperpoint& b) { return a[0]*b[0] + a[1]*b[1] + a[2]*b[2] + a[3]*b[3]; }
+inline ld length3(const hyperpoint& a) { return sqrt(a[0]*a[0] + a[1]*a[1] + a[2]*a[2]); }
+
+/** the function len of the GLSL program */
+inline ld len(const hyperpoint& h) { return hyperbolic ? h[3] : length3(h); }
+
+/** the GLSL xpush(x) * h */
+inline hyperpoint xpushed(ld x, const hyperpoint& h) {
+  ld c = cosh(x), s = sinh(x);
+  return hyperpoint(c * h[0] + s * h[3], h[1], h[2], s * h[0] + c * h[3]);
+  }
+
+hyperpoint christoffel(const hyperpoint& pos, const hyperpoint& vel, const hyperpoint& tra) {
+  if(sol && nih) return hyperpoint(
+    -(vel[2]*tra[0] + vel[0]*tra[2])*log(2), (vel[2]*tra[1] + vel[1]*tra[2])*log(3),
+    vel[0]*tra[0] * exp(2*log(2)*pos[2])*log(2) - vel[1]*tra[1] * exp(-2*log(3)*pos[2])*log(3), 0);
+  else if(nih) return hyperpoint(
+    (vel[2]*tra[0] + vel[0]*tra[2])*log(2), (vel[2]*tra[1] + vel[1]*tra[2])*log(3),
+    -vel[0]*tra[0] * exp(-2*log(2)*pos[2])*log(2) - vel[1]*tra[1] * exp(-2*log(3)*pos[2])*log(3), 0);
+  else if(sol) return hyperpoint(
+    -vel[2]*tra[0] - vel[0]*tra[2], vel[2]*tra[1] + vel[1]*tra[2],
+    vel[0]*tra[0] * exp(2*pos[2]) - vel[1]*tra[1] * exp(-2*pos[2]), 0);
+  else {
+    ld x = pos[0];
+    return hyperpoint(
+      x*vel[1]*tra[1] - 0.5*(vel[1]*tra[2] + vel[2]*tra[1]),
+      -.5*x*(vel[1]*tra[0] + vel[0]*tra[1]) + .5*(vel[2]*tra[0] + vel[0]*tra[2]),
+      -.5*(x*x-1)*(vel[1]*tra[0] + vel[0]*tra[1]) + .5*x*(vel[2]*tra[0] + vel[0]*tra[2]), 0);
+    }
+  }
+
+/* Nil translations, as in the GLSL program */
+hyperpoint nil_translate(const hyperpoint& a, const hyperpoint& b) { return hyperpoint(a[0] + b[0], a[1] + b[1], a[2] + b[2] + a[0] * b[1], b[3]); }
+hyperpoint nil_translatev(const hyperpoint& a, const hyperpoint& t) { return hyperpoint(t[0], t[1], t[2] + a[0] * t[1], 0); }
+hyperpoint nil_itranslate(const hyperpoint& a, const hyperpoint& b) { return hyperpoint(-a[0] + b[0], -a[1] + b[1], -a[2] + b[2] - a[0] * (b[1]-a[1]), b[3]); }
+hyperpoint nil_itranslatev(const hyperpoint& a, const hyperpoint& t) { return hyperpoint(t[0], t[1], t[2] - a[0] * t[1], 0); }
+
+hyperpoint asonov_refl(hyperpoint t, ld z, const hyperpoint& r) {
+  t[0] *= exp(z); t[1] /= exp(z);
+  t -= dot4(t, r) * r;
+  t[0] /= exp(z); t[1] *= exp(z);
+  return t;
+  }
+
+pair<ld, ld> map_texture(const cpu_context& cx, hyperpoint pos, int which) {
+  if(nil) { if(which == 2 || which == 5) pos[2] = 0; }
+  else if(hyperbolic && binarytiling) {
+    pos = hyperpoint(-log(pos[3]-pos[0]), pos[1], pos[2], 1);
+    pos[1] *= exp(pos[0]); pos[2] *= exp(pos[0]);
+    }
+  else if(hyperbolic) pos /= pos[3];
+  else if(prod) pos = hyperpoint(pos[0]/pos[2], pos[1]/pos[2], pos[3], 0);
+  int s = cx.wallstart[which];
+  int e = cx.wallstart[which+1];
+  for(int ix=0; ix<16; ix++) {
+    int i = s+ix; if(i >= e) break;
+    ld vx = dot4(cx.wallx[i], pos), vy = dot4(cx.wally[i], pos);
+    if(vx >= 0 && vy >= 0 && vx + vy <= 1) return make_pair(vx+vy, vx-vy);
+    }
+  return make_pair(1, 1);
+  }
+
+void init_ray(const cpu_context& cx, ray_state& r, ld atx, ld aty) {
+  hyperpoint& at0 = r.at0;
+  at0 = hyperpoint(atx, -aty, 1, 0);
+  at0 /= length3(at0);
+  const transmatrix& vw = cx.t->start;
+  if(prod) {
+    hyperpoint at1 = cx.LP * at0;
+    r.position = vw * hyperpoint(0, 0, 1, 0);
+    auto& p = r.position;
+    ld sgn = in_h2xe() ? -1 : 1;
+    r.zpos = log(p[2]*p[2] + sgn*p[0]*p[0] + sgn*p[1]*p[1])/2;
+    p *= exp(-r.zpos);
+    r.zspeed = at1[2];
+    r.xspeed = hypot(at1[0], at1[1]);
+    r.tangent = vw * hyperpoint(at1[0], at1[1], 0, 0) * exp(-r.zpos) / r.xspeed;
+    }
+  else {
+    r.position = vw * C03;
+    r.tangent = vw * at0;
+    r.zpos = r.zspeed = r.xspeed = 0;
+    }
+  r.go = 0;
+  r.left = 1;
+  r.next = cx.maxstep;
+  r.cid = cx.t->start_id;
+  r.active = true;
+  r.depthtoset = true;
+  r.col[0] = r.col[1] = r.col[2] = 0;
+  r.depth = 1;
+  }
+
+/** find the wall which the ray hits first, in the isotropic geometries */
+void find_wall(const cpu_context& cx, const ray_state& r, ld& dist, int& which) {
+  dist = 100; which = -1;
+  auto& position = r.position;
+  auto& tangent = r.tangent;
+  auto& ms = cx.t->ms;
+  for(int i=cx.flat1; i<cx.flat2; i++) {
+    const transmatrix& M = ms[i];
+    ld d;
+    if(in_h2xe()) {
+      ld v = ((position - M * position)[2] / (M * tangent - tangent)[2]);
+      if(v > 1 || v < -1) continue;
+      d = atanh(v);
+      hyperpoint next_tangent = position * sinh(d) + tangent * cosh(d);
+      if(next_tangent[2] < (M * next_tangent)[2]) continue;
+      d /= r.xspeed;
+      }
+    else if(in_s2xe()) {
+      ld v = ((position - M * position)[2] / (M * tangent - tangent)[2]);
+      d = atan(v);
+      hyperpoint next_tangent = tangent * cos(d) - position * sin(d);
+      if(next_tangent[2] > (M * next_tangent)[2]) continue;
+      d /= r.xspeed;
+      }
+    else if(hyperbolic) {
+      ld v = ((position - M * position)[3] / (M * tangent - tangent)[3]);
+      if(v > 1 || v < -1) continue;
+      d = atanh(v);
+      hyperpoint next_tangent = position * sinh(d) + tangent * cosh(d);
+      if(next_tangent[3] < (M * next_tangent)[3]) continue;
+      }
+    else {
+      hyperpoint Mp = M * position, Mt = M * tangent;
+      ld deno = dot4(position, tangent) - dot4(Mp, Mt);
+      if(deno < 1e-6 && deno > -1e-6) continue;
+      d = (dot4(Mp, Mp) - dot4(position, position)) / 2 / deno;
+      if(d < 0) continue;
+      hyperpoint next_position = position + d * tangent;
+      if(dot4(next_position, tangent) < dot4(M*next_position, Mt)) continue;
+      }
+    if(d < dist) { dist = d; which = i; }
+    }
+
+  /* 20: get to horosphere +uBLevel (take smaller root); 21: get to horosphere -uBLevel (take larger root) */
+  if(hyperbolic && binarytiling) for(int i=20; i<22; i++) {
+    ld sgn = i == 20 ? -1 : 1;
+    hyperpoint zp = xpushed(cx.blevel*sgn, position);
+    hyperpoint zt = xpushed(cx.blevel*sgn, tangent);
+    ld Mp = zp[3] - zp[0];
+    ld Mt = zt[3] - zt[0];
+    ld a = (Mp*Mp-Mt*Mt);
+    ld b = Mp/a;
+    ld c = (1+Mt*Mt) / a;
+    if(b*b < c) continue;
+    if(sgn < 0 && Mt > 0) continue;
+    ld zsgn = (Mt > 0 ? -sgn : sgn);
+    ld u = sqrt(b*b-c)*zsgn + b;
+    ld v = -(Mp*u-1) / Mt;
+    ld d = asinh(v);
+    if(d < 0 && abs(log(position[3]*position[3]-position[0]*position[0])) < cx.blevel) continue;
+    if(d < dist) { dist = d; which = i; }
+    }
+
+  if(prod) {
+    if(r.zspeed > 0) { ld d = (cx.plevel - r.zpos) / r.zspeed; if(d < dist) { dist = d; which = S7+1; }}
+    if(r.zspeed < 0) { ld d = (-cx.plevel - r.zpos) / r.zspeed; if(d < dist) { dist = d; which = S7; }}
+    }
+  }
+
+/** find_wall for all the rays in a packet at once; only in hyperbolic and Euclidean geometries, without binary tilings */
+void find_walls_simd(const cpu_context& cx, const ray_state *r, ld *dist, int *which) {
+  hyperpoint pos[SIMD_LANES], tan[SIMD_LANES];
+  for(int j=0; j<SIMD_LANES; j++) pos[j] = r[j].position, tan[j] = r[j].tangent;
+  simd_ld px, py, pz, pw, tx, ty, tz, tw;
+  simd_load(pos, px, py, pz, pw);
+  simd_load(tan, tx, ty, tz, tw);
+  simd_ld none = simd_const(hyperbolic ? 2 : 100);
+  /* in hyperbolic geometry, atanh is monotonic, so we look for the smallest v = tanh(d) below tanh(100) = 1 */
+  simd_ld best = simd_const(hyperbolic ? 1 : 100), bestwhich = simd_const(-1);
+  auto& ms = cx.t->ms;
+  for(int i=cx.flat1; i<cx.flat2; i++) {
+    const transmatrix& M = ms[i];
+    simd_ld cand;
+    if(hyperbolic) {
+      simd_ld Mp3 = simd_const(M[3][0]) * px + simd_const(M[3][1]) * py + simd_const(M[3][2]) * pz + simd_const(M[3][3]) * pw;
+      simd_ld Mt3 = simd_const(M[3][0]) * tx + simd_const(M[3][1]) * ty + simd_const(M[3][2]) * tz + simd_const(M[3][3]) * tw;
+      simd_ld v = (pw - Mp3) / (Mt3 - tw);
+      /* the next tangent is proportional to position * v + tangent */
+      simd_ld n3 = pw * v + tw, Mn3 = Mp3 * v + Mt3;
+      cand = simd_if_less(simd_const(1), v, none, v);
+      cand = simd_if_less(v, simd_const(-1), none, cand);
+      cand = simd_if_less(n3, Mn3, none, cand);
+      }
+    else {
+      simd_ld Mp[4], Mt[4];
+      for(int k=0; k<4; k++) {
+        Mp[k] = simd_const(M[k][0]) * px + simd_const(M[k][1]) * py + simd_const(M[k][2]) * pz + simd_const(M[k][3]) * pw;
+        Mt[k] = simd_const(M[k][0]) * tx + simd_const(M[k][1]) * ty + simd_const(M[k][2]) * tz + simd_const(M[k][3]) * tw;
+        }
+      simd_ld pt = px*tx + py*ty + pz*tz + pw*tw;
+      simd_ld pp = px*px + py*py + pz*pz + pw*pw;
+      simd_ld MpMt = Mp[0]*Mt[0] + Mp[1]*Mt[1] + Mp[2]*Mt[2] + Mp[3]*Mt[3];
+      simd_ld MpMp = Mp[0]*Mp[0] + Mp[1]*Mp[1] + Mp[2]*Mp[2] + Mp[3]*Mp[3];
+      simd_ld MtMt = Mt[0]*Mt[0] + Mt[1]*Mt[1] + Mt[2]*Mt[2] + Mt[3]*Mt[3];
+      simd_ld tt = tx*tx + ty*ty + tz*tz + tw*tw;
+      simd_ld deno = pt - MpMt;
+      simd_ld d = (MpMp - pp) / simd_const(2) / deno;
+      /* dot(position + d * tangent, tangent) < dot(M * (position + d * tangent), M * tangent) */
+      simd_ld lhs = pt + d * tt, rhs = MpMt + d * MtMt;
+      cand = simd_if_less(d, simd_const(0), none, d);
+      cand = simd_if_less(lhs, rhs, none, cand);
+      cand = simd_if_less(deno, simd_const(1e-6), simd_if_less(simd_const(-1e-6), deno, none, cand), cand);
+      }
+    bestwhich = simd_if_less(cand, best, simd_const(i), bestwhich);
+    best = simd_if_less(cand, best, cand, best);
+    }
+  ld bv[SIMD_LANES], bw[SIMD_LANES];
+  memcpy(bv, &best, sizeof(bv));
+  memcpy(bw, &bestwhich, sizeof(bw));
+  for(int j=0; j<SIMD_LANES; j++) {
+    which[j] = int(bw[j]);
+    dist[j] = which[j] == -1 ? 100 : hyperbolic ? atanh(bv[j]) : bv[j];
+    }
+  }
+
+/** do the rest of one iteration of the GLSL main loop, after the wall has been found; false if the ray is finished */
+bool advance(const cpu_context& cx, ray_state& r, ld dist, int which) {
+  if(!nonisotropic) {
+    if(dist < 0) dist = 0;
+    if(which == -1 && dist == 0) return false;
+    }
+
+  auto& position = r.position;
+  auto& tangent = r.tangent;
+  auto& ms = cx.t->ms;
+  bool reflect = false;
+
+  if(in_h2xe()) {
+    ld ch = cosh(dist*r.xspeed), sh = sinh(dist*r.xspeed);
+    hyperpoint v = position * ch + tangent * sh;
+    tangent = tangent * ch + position * sh;
+    position = v;
+    r.zpos += dist * r.zspeed;
+    }
+  else if(in_s2xe()) {
+    ld ch = cos(dist*r.xspeed), sh = sin(dist*r.xspeed);
+    hyperpoint v = position * ch + tangent * sh;
+    tangent = tangent * ch - position * sh;
+    position = v;
+    r.zpos += dist * r.zspeed;
+    }
+  else if(hyperbolic) {
+    ld ch = cosh(dist), sh = sinh(dist);
+    hyperpoint v = position * ch + tangent * sh;
+    tangent = tangent * ch + position * sh;
+    position = v;
+    }
+  else if(nonisotropic) {
+    dist = r.next < cx.minstep ? 2*r.next : r.next;
+    if(nil) tangent = nil_translate(position, nil_itranslate(position, tangent));
+
+    hyperpoint nposition, acc, xt;
+    if(solnih) {
+      acc = christoffel(position, tangent, tangent);
+      hyperpoint pos2 = position + tangent * dist / 2;
+      hyperpoint tan2 = tangent + acc * dist / 2;
+      hyperpoint acc2 = christoffel(pos2, tan2, tan2);
+      nposition = position + tangent * dist + acc2 / 2 * dist * dist;
+      }
+
+    if(nil) {
+      hyperpoint xp;
+      hyperpoint back = nil_itranslatev(position, tangent);
+      if(back[0] == 0 && back[1] == 0) {
+        xp = hyperpoint(0, 0, back[2]*dist, 1);
+        xt = back;
+        }
+      else if(abs(back[2]) == 0) {
+        xp = hyperpoint(back[0]*dist, back[1]*dist, back[0]*back[1]*dist*dist/2, 1);
+        xt = hyperpoint(back[0], back[1], dist*back[0]*back[1], 0);
+        }
+      else if(abs(back[2]) < 1e-1) {
+        /* the GLSL program uses the midpoint method here, because of the float precision */
+        hyperpoint acc = christoffel(C03, back, back);
+        hyperpoint pos2 = back * dist / 2;
+        hyperpoint tan2 = back + acc * dist / 2;
+        hyperpoint acc2 = christoffel(pos2, tan2, tan2);
+        xp = C03 + back * dist + acc2 / 2 * dist * dist;
+        xt = back + acc * dist;
+        }
+      else {
+        ld alpha = atan2(back[1], back[0]);
+        ld w = back[2] * dist;
+        ld c = hypot(back[0], back[1]) / back[2];
+        xp = hyperpoint(2*c*sin(w/2) * cos(w/2+alpha), 2*c*sin(w/2)*sin(w/2+alpha), w*(1+(c*c/2)*((1-sin(w)/w)+(1-cos(w))/w * sin(w+2*alpha))), 1);
+        xt = back[2] * hyperpoint(c*cos(alpha+w), c*sin(alpha+w), 1 + c*c*2*sin(w/2)*sin(alpha+w)*cos(alpha+w/2), 0);
+        }
+      nposition = nil_translate(position, xp);
+      }
+
+    ld rz = 0;
+    if(nil) rz = (abs(nposition[0]) > abs(nposition[1]) ? -nposition[0]*nposition[1] : 0) + nposition[2];
+
+    hyperpoint sp = cx.straighten * nposition;
+    auto& np = nposition;
+    ld bw = cx.binary_width;
+
+    if(r.next >= cx.minstep) {
+      bool out;
+      if(cx.asonov) out = abs(sp[0]) > 1 || abs(sp[1]) > 1 || abs(sp[2]) > 1;
+      else if(nih) out = abs(np[0]) > bw || abs(np[1]) > bw || abs(np[2]) > .5;
+      else if(sol) out = abs(np[0]) > bw || abs(np[1]) > bw || abs(np[2]) > log(2)/2;
+      else out = abs(np[0]) > .5 || abs(np[1]) > .5 || abs(rz) > .5;
+      if(out) { r.next = dist / 2; return true; }
+      if(r.next < cx.maxstep) r.next = r.next / 2;
+      }
+    else {
+      if(solnih) {
+        if(cx.asonov) {
+          if(sp[0] > 1) which = 4;
+          if(sp[1] > 1) which = 5;
+          if(sp[0] <-1) which = 10;
+          if(sp[1] <-1) which = 11;
+          if(sp[2] > 1) {
+            ld best = 999;
+            for(int i=0; i<4; i++) {
+              ld cand = len(cx.straighten * ms[i] * position);
+              if(cand < best) { best = cand; which = i; }
+              }
+            }
+          if(sp[2] < -1) {
+            ld best = 999;
+            for(int i=6; i<10; i++) {
+              ld cand = len(cx.straighten * ms[i] * position);
+              if(cand < best) { best = cand; which = i; }
+              }
+            }
+          }
+        else if(sol && !nih) {
+          if(np[0] > bw) which = 0;
+          if(np[0] <-bw) which = 4;
+          if(np[1] > bw) which = 1;
+          if(np[1] <-bw) which = 5;
+          }
+        if(nih) {
+          if(np[0] > bw) which = 0;
+          if(np[0] <-bw) which = 2;
+          if(np[1] > bw) which = 1;
+          if(np[1] <-bw) which = 3;
+          }
+        if(sol && nih) {
+          if(np[2] > .5) which = np[0] > 0 ? 5 : 4;
+          if(np[2] <-.5) which = np[1] > bw/3 ? 8 : np[1] < -bw/3 ? 6 : 7;
+          }
+        if(nih && !sol) {
+          if(np[2] > .5) which = 4;
+          if(np[2] < -.5) which = (np[1] > bw/3 ? 9 : np[1] < -bw/3 ? 5 : 7) + (np[0]>0?1:0);
+          }
+        if(sol && !nih && !cx.asonov) {
+          if(np[2] > log(2)/2) which = np[0] > 0 ? 3 : 2;
+          if(np[2] <-log(2)/2) which = np[1] > 0 ? 7 : 6;
+          }
+        }
+      else {
+        if(np[0] > .5) which = 3;
+        if(np[0] <-.5) which = 0;
+        if(np[1] > .5) which = 4;
+        if(np[1] <-.5) which = 1;
+        if(rz > .5) which = 5;
+        if(rz <-.5) which = 2;
+        }
+      r.next = cx.maxstep;
+      }
+
+    if(nil) tangent = nil_translatev(position, xt);
+    position = nposition;
+    if(!nil) tangent = tangent + acc * dist;
+    }
+  else
+    position = position + tangent * dist;
+
+  #if CAP_FIX_RAYCAST
+  if(hyperbolic) {
+    position /= sqrt(position[3]*position[3] - position[0]*position[0] - position[1]*position[1] - position[2]*position[2]);
+    tangent -= (position[3]*tangent[3] - position[0]*tangent[0] - position[1]*tangent[1] - position[2]*tangent[2]) * position;
+    tangent /= sqrt(tangent[0]*tangent[0] + tangent[1]*tangent[1] + tangent[2]*tangent[2] - tangent[3]*tangent[3]);
+    }
+  #endif
+
+  if(hyperbolic && binarytiling) {
+    if(which == 20) {
+      ld best = 999;
+      for(int i=cx.flat2; i<S7; i++) {
+        ld cand = len(ms[i] * position);
+        if(cand < best) { best = cand; which = i; }
+        }
+      }
+    if(which == 21) {
+      ld best = 999;
+      for(int i=0; i<cx.flat1; i++) {
+        ld cand = len(ms[i] * position);
+        if(cand < best) { best = cand; which = i; }
+        }
+      }
+    }
+
+  r.go += dist;
+
+  if(which == -1) return true;
+
+  if(prod) position[3] = -r.zpos;
+
+  int u = r.cid * deg + which;
+  glvertex wcol = cx.t->wallcolor[u];
+  ld col[4] = {wcol[0], wcol[1], wcol[2], wcol[3]};
+  if(col[3] > 0) {
+    if(hard_limit < NO_LIMIT && r.go > hard_limit) { r.depth = 1; return false; }
+
+    if(!(levellines && disable_texture)) {
+      auto inface = map_texture(cx, position, which);
+      glvertex tmap = cx.t->texturemap[u];
+      if(tmap[2] != 0 && !cx.textured) tmap = glhr::makevertex(0.1, 0, 0);
+      if(tmap[2] == 0) {
+        ld p = min<ld>(1, (1-inface.first) / tmap[0]);
+        for(int a=0; a<3; a++) col[a] *= p;
+        }
+      else {
+        auto tcol = sample_texture(tmap[0] + tmap[2] * inface.first, tmap[1] + tmap[2] * inface.second);
+        for(int a=0; a<3; a++) col[a] *= tcol[a];
+        }
+      }
+
+    ld d = max(1 - r.go / cx.linear_sight_range, cx.exp_start * exp(-r.go / cx.exp_decay));
+    for(int a=0; a<3; a++) col[a] = col[a] * d + cx.fog[a] * (1-d);
+
+    if(nil && abs(abs(position[0])-abs(position[1])) < .005)
+      for(int a=0; a<3; a++) col[a] /= 2;
+
+    if(cx.use_reflect && col[3] == 1) {
+      col[3] = 1 - reflect_val;
+      reflect = true;
+      }
+
+    for(int a=0; a<3; a++) r.col[a] += r.left * col[a] * col[3];
+
+    if(cx.use_reflect ? (reflect && r.depthtoset) : col[3] == 1) {
+      ld z = hyperbolic ? r.at0[2] * sinh(r.go) : r.at0[2] * r.go;
+      ld w = 1;
+      if(levellines) {
+        ld ll = hyperbolic ? z/cosh(r.go) : z;
+        for(int a=0; a<3; a++) r.col[a] *= 0.5 + 0.5 * cos(ll * levellines * 2 * M_PI);
+        }
+      ld depth = (-(cx.vnear+cx.vfar)+w*(2*cx.vnear*cx.vfar)/z)/(cx.vnear-cx.vfar);
+      r.depth = (depth + 1) / 2;
+      if(!cx.use_reflect) return false;
+      r.depthtoset = false;
+      }
+    r.left *= (1 - col[3]);
+    }
+
+  if(cx.use_reflect) {
+    if(prod && reflect && which >= S7) { r.zspeed = -r.zspeed; return true; }
+    if(hyperbolic && binarytiling && reflect && (which < cx.flat1 || which >= cx.flat2)) {
+      ld x = -log(position[3] - position[0]);
+      hyperpoint xtan = xpushed(-x, tangent);
+      ld diag = (position[1]*position[1]+position[2]*position[2])/2;
+      hyperpoint normal = hyperpoint(1-diag, -position[1], -position[2], -diag);
+      ld mdot = xtan[0]*normal[0] + xtan[1]*normal[1] + xtan[2]*normal[2] - xtan[3]*normal[3];
+      xtan = xtan - normal * mdot * 2;
+      tangent = xpushed(x, xtan);
+      return true;
+      }
+    if(cx.asonov) {
+      /* no continue here, as in the GLSL program */
+      if(reflect) {
+        if(which == 4 || which == 10) tangent = asonov_refl(tangent, position[2], cx.reflectx);
+        else if(which == 5 || which == 11) tangent = asonov_refl(tangent, position[2], cx.reflecty);
+        else tangent[2] = -tangent[2];
+        }
+      }
+    else if(sol && !nih) {
+      if(reflect) {
+        if(which == 0 || which == 4) tangent[0] = -tangent[0];
+        else if(which == 1 || which == 5) tangent[1] = -tangent[1];
+        else tangent[2] = -tangent[2];
+        return true;
+        }
+      }
+    else if(nih) {
+      if(reflect) {
+        if(which == 0 || which == 2) tangent[0] = -tangent[0];
+        else if(which == 1 || which == 3) tangent[1] = -tangent[1];
+        else tangent[2] = -tangent[2];
+        return true;
+        }
+      }
+    else if(reflect) {
+      tangent = ms[deg+which] * tangent;
+      return true;
+      }
+    }
+
+  /* next cell; out of range connections lead to cell 0, as in the texture */
+  int c1 = cx.t->conn_cell[u];
+  r.cid = max(c1, 0);
+
+  if(prod) {
+    if(which == S7) { r.zpos += cx.plevel+cx.plevel; return true; }
+    if(which == S7+1) { r.zpos -= cx.plevel+cx.plevel; return true; }
+    }
+
+  int mid = c1 >= 0 ? cx.t->conn_matrix[u] : 0;
+  transmatrix T = ms[mid] * ms[which];
+  position = T * position;
+  tangent = T * tangent;
+  return true;
+  }
+
+/** the ray has run out of iterations */
+void finish(const cpu_context& cx, ray_state& r) {
+  for(int a=0; a<3; a++) r.col[a] += r.left * cx.fog[a];
+  if(r.depthtoset) r.depth = 1;
+  }
+
+color_t ray_color(const ray_state& r) {
+  color_t res = 0xFF000000;
+  for(int a=0; a<3; a++) {
+    int v = int(floor(r.col[a] * 255 + .5));
+    part(res, 2-a) = v < 0 ? 0 : v > 255 ? 255 : v;
+    }
+  return res;
+  }
+
+/** trace the pixel row y (counted from the bottom, as in OpenGL) of a w x h image */
+void trace_row(const cpu_context& cx, int y, int w, int h, color_t *pix, float *depth) {
+  ld aty = ((y + .5) / h * 2 - 1) * cx.fovy;
+  for(int x0=0; x0<w; x0+=SIMD_LANES) {
+    ray_state r[SIMD_LANES];
+    for(int j=0; j<SIMD_LANES; j++) {
+      int x = min(x0+j, w-1);
+      ld atx = ((x + .5) / w * 2 - 1 + cx.shift) * cx.fovx;
+      init_ray(cx, r[j], atx, aty);
+      }
+    ld dist[SIMD_LANES];
+    int which[SIMD_LANES];
+    for(int j=0; j<SIMD_LANES; j++) dist[j] = 0, which[j] = -1;
+    for(int iter=0; iter<cx.max_iter; iter++) {
+      bool any = false;
+      for(auto& rj: r) any |= rj.active;
+      if(!any) break;
+      if(cx.simd_walls) find_walls_simd(cx, r, dist, which);
+      else if(!nonisotropic) for(int j=0; j<SIMD_LANES; j++) if(r[j].active) find_wall(cx, r[j], dist[j], which[j]);
+      for(int j=0; j<SIMD_LANES; j++) if(r[j].active && !advance(cx, r[j], dist[j], which[j])) r[j].active = false;
+      }
+    for(int j=0; j<SIMD_LANES && x0+j<w; j++) {
+      if(r[j].active) finish(cx, r[j]);
+      pix[x0+j] = ray_color(r[j]);
+      depth[x0+j] = r[j].depth;
+      }
+    }
+  }
+
+/** trace a w x h image, with rows counted from the bottom */
+void trace_image(const cpu_context& cx, int w, int h, vector<color_t>& pix, vector<float>& depth) {
+  pix.resize(w * h);
+  depth.resize(w * h);
+  auto row = [&] (int y) { trace_row(cx, y, w, h, &pix[y * w], &depth[y * w]); };
+  #if CAP_THREAD
+  int threads = cpu_threads ? cpu_threads : max<int>(std::thread::hardware_concurrency(), 1);
+  if(threads > 1 && h > 1) {
+    std::atomic<int> next(0);
+    auto work = [&] {
+      while(true) {
+        int y = next++;
+        if(y >= h) return;
+        row(y);
+        }
+      };
+    vector<std::thread> workers;
+    for(int i=1; i<threads; i++) workers.emplace_back(work);
+    work();
+    for(auto& w: workers) w.join();
+    }
+  else
+  #endif
+    for(int y=0; y<h; y++) row(y);
+  }
+
+/** the part of the screen covered by the raycaster, as in display_data::set_viewport */
+void cpu_viewport(int& x0, int& y0, int& w, int& h) {
+  auto cd = current_display;
+  x0 = cd->xtop; y0 = cd->ytop; w = cd->xsize; h = cd->ysize;
+  if(global_projection && vid.stereo_mode == sLR) {
+    w /= 2;
+    if(global_projection == -1) x0 += w;
+    }
+  }
+
+/** can the CPU raycaster output its image with the current renderer? */
+EX bool cpu_output_available() {
+  #if CAP_GL && !defined(GLES_ONLY) && !ISWEB
+  if(vid.usingGL) return true;
+  #endif
+  #if CAP_SDL
+  if(!vid.usingGL) return s;
+  #endif
+  return false;
+  }
+
+/** the CPU version of cast */
+EX void cast_cpu() {
+  auto t0 = profile_clock();
+  cpu_context cx;
+  setup_context(cx);
+  int x0, y0, w, h;
+  cpu_viewport(x0, y0, w, h);
+  if(w <= 0 || h <= 0) return;
+  vector<color_t> pix;
+  vector<float> depth;
+  trace_image(cx, w, h, pix, depth);
+
+  #if CAP_GL && !defined(GLES_ONLY) && !ISWEB
+  if(vid.usingGL) {
+    glUseProgram(0);
+    glhr::current_glprogram = nullptr;
+    glWindowPos2i(x0, y0);
+    glhr::set_depthtest(false);
+    if(comparison_mode) glColorMask(GL_TRUE, GL_FALSE, GL_FALSE, GL_TRUE);
+    glDrawPixels(w, h, GL_BGRA, GL_UNSIGNED_BYTE, &pix[0]);
+    if(!comparison_mode) {
+      /* the depth buffer is only written when the depth test is on */
+      GLint func;
+      glGetIntegerv(GL_DEPTH_FUNC, &func);
+      glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+      glhr::set_depthtest(true);
+      glhr::set_depthwrite(true);
+      glDepthFunc(GL_ALWAYS);
+      glWindowPos2i(x0, y0);
+      glDrawPixels(w, h, GL_DEPTH_COMPONENT, GL_FLOAT, &depth[0]);
+      glDepthFunc(func);
+      glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+      }
+    GLERR("cast_cpu");
+    }
+  #endif
+  #if CAP_SDL
+  if(!vid.usingGL && s) {
+    SDL_LockSurface(s);
+    for(int y=0; y<h; y++) for(int x=0; x<w; x++) {
+      int sx = x0 + x, sy = y0 + h-1-y;
+      if(sx < 0 || sy < 0 || sx >= s->w || sy >= s->h) continue;
+      color_t c = pix[y * w + x];
+      auto& p = qpixel(s, sx, sy);
+      if(comparison_mode) p = (p & 0xFF00FFFF) | (c & 0xFF0000);
+      else p = c;
+      }
+    SDL_UnlockSurface(s);
+    }
+  #endif
+
+  cpu_rays = w * h;
+  cpu_ms = (profile_clock() - t0) / 1e6;
+  DEBB(DF_GRAPH, ("CPU raycaster: ", cpu_rays, " rays in ", cpu_ms, " ms, ", cpu_rays / cpu_ms / 1000, " Mrays/s"));
+  }
+
+/** trace the current view frames times in a few configurations, and print the throughput */
+EX void cpu_benchmark(int frames) {
+  cpu_context cx;
+  auto t0 = profile_clock();
+  setup_context(cx);
+  ld setup_ms = (profile_clock() - t0) / 1e6;
+  int x0, y0, w, h;
+  cpu_viewport(x0, y0, w, h);
+  println(hlog, "CPU raycaster: ", w, "x", h, " pixels, ", isize(cx.t->lst), " cells, tables built in ", setup_ms, " ms");
+  vector<color_t> pix;
+  vector<float> depth;
+  int hw = 1;
+  #if CAP_THREAD
+  hw = max<int>(std::thread::hardware_concurrency(), 1);
+  #endif
+  int threads = cpu_threads ? cpu_threads : hw;
+  for(int conf=0; conf<3; conf++) {
+    dynamicval<int> dt(cpu_threads, conf < 2 ? 1 : threads);
+    dynamicval<bool> ds(cpu_simd, conf > 0);
+    cx.simd_walls = cpu_simd && !nonisotropic && !prod && !binarytiling && (hyperbolic || euclid);
+    auto t1 = profile_clock();
+    for(int i=0; i<frames; i++) trace_image(cx, w, h, pix, depth);
+    ld ms = (profile_clock() - t1) / 1e6 / frames;
+    println(hlog, format("  %d thread(s), %s: %.2f ms per frame, %.3f Mrays/s",
+      cpu_threads, cx.simd_walls ? (its(SIMD_LANES) + " SIMD lanes").c_str() : "scalar", double(ms), double(w * h / ms / 1000)));
+    }
+  }
+
+/** render the current view with the GPU and CPU raycasters, and compare the images */
+EX void cpu_diff_test() {
+  if(!vid.usingGL) { println(hlog, "ray cpu diff: the GPU raycaster requires OpenGL"); return; }
+  dynamicval<int> wu(want_use, 2);
+  resetbuffer rb;
+  calcparam();
+  models::configure();
+  renderbuffer buf(vid.xres, vid.yres, true);
+  vector<color_t> img[2];
+  ld ms[2];
+  for(int i=0; i<2; i++) {
+    dynamicval<bool> dc(cpu, i);
+    buf.enable();
+    current_display->set_viewport(0);
+    buf.clear(backcolor);
+    auto t0 = profile_clock();
+    drawfullmap();
+    glFinish();
+    ms[i] = (profile_clock() - t0) / 1e6;
+    auto srf = buf.render();
+    for(int y=0; y<vid.yres; y++) for(int x=0; x<vid.xres; x++) img[i].push_back(qpixel(srf, x, y));
+    }
+  rb.reset();
+
+  int differ = 0;
+  double total = 0;
+  int qty = vid.xres * vid.yres;
+  for(int i=0; i<qty; i++) {
+    int worst = 0;
+    for(int p=0; p<3; p++) {
+      int d = abs(part(img[0][i], p) - part(img[1][i], p));
+      total += d; worst = max(worst, d);
+      }
+    if(worst > 64) differ++;
+    }
+  println(hlog, format("ray cpu: GPU %.1f ms, CPU %.1f ms; %d of %d pixels (%.2f%%) differ, mean difference %.3f",
+    double(ms[0]), double(ms[1]), differ, qty, differ * 100. / qty, total / qty / 3));
+  println(hlog, differ <= qty / 50 ? "ray cpu image diff: OK" : "ray cpu image diff: FAILED");
+  }
+
+#if CAP_COMMANDLINE
+int read_cpu_args() {
+  using namespace arg;
+  if(0) ;
+  else if(argis("-ray-cpu")) {
+    PHASEFROM(2); cpu = true;
+    }
+  else if(argis("-ray-gpu")) {
+    PHASEFROM(2); cpu = false;
+    }
+  else if(argis("-ray-cpu-threads")) {
+    PHASEFROM(2); shift(); cpu_threads = argi();
+    }
+  else if(argis("-ray-cpu-simd")) {
+    PHASEFROM(2); shift(); cpu_simd = argi();
+    }
+  else if(argis("-ray-cpu-bench")) {
+    PHASE(3); start_game(); shift(); cpu_benchmark(argi());
+    }
+  else if(argis("-ray-cpu-diff")) {
+    PHASE(3); start_game(); cpu_diff_test();
+    }
+  else return 1;
+  return 0;
+  }
+
+auto ah_cpu = addHook(hooks_args, 100, read_cpu_args);
+#endif
+
+#endif
+
+EX }
+}
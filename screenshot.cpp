@@ -764,6 +764,176 @@ bool record_animation() {
   }
 #endif
 
+/** statistics of a single frame rendered by bench_frames; times in milliseconds */
+struct frame_stats {
+  double traversal, cell_draw, queue_sort, rasterize, total;
+  /** the part of rasterize spent on the CPU, before waiting for the GPU to finish */
+  double submit;
+  int cells_drawn, draw_items;
+  /** glDrawArrays calls for polygons, instanced draws, and the polygons drawn by them */
+  int draw_calls, instanced_draws, instanced_polys;
+  /** whole heptagons skipped by the smart range, and the cells in them */
+  int patches_culled, cells_culled;
+  long long allocations;
+  /** reductions made by the frame budget governor */
+  int range_reduction, detail_reduction, line_reduction;
+  };
+
+/** render n frames offscreen along the animation path (a translation if no animation is set) */
+vector<frame_stats> render_frames(int n) {
+  dynamicval<eMovementAnimation> dma(ma, any_animation() ? ma : maTranslation);
+  dynamicval<bool> dp(profiling, true);
+  dynamicval<videopar> v(vid, vid);
+  shot::set_shotx();
+  vid.xres = shot::shotx;
+  vid.yres = shot::shoty;
+  calcparam();
+  models::configure();
+
+  resetbuffer rb;
+  renderbuffer glbuf(vid.xres, vid.yres, vid.usingGL);
+
+  vector<frame_stats> stats;
+  lastticks = 0;
+  ticks = 0;
+  for(int i=0; i<n; i++) {
+    int newticks = i * period / n;
+    while(ticks < newticks) shmup::turn(1), ticks++;
+    apply();
+    models::configure();
+    glbuf.enable();
+    current_display->set_viewport(0);
+    glbuf.clear(backcolor);
+
+    auto ms = [] (int cat) { return proftable[cat][pframeid] / 1e6; };
+    frame_stats fs;
+    long long allocs = get_alloc_count();
+    long long t = profile_clock();
+    drawfullmap();
+    fs.submit = ms(prof_rasterize);
+    #if CAP_GL
+    if(vid.usingGL) {
+      profile_start(prof_rasterize);
+      glFinish();
+      profile_stop(prof_rasterize);
+      }
+    #endif
+    t = profile_clock() - t;
+
+    fs.cell_draw = ms(prof_cells);
+    fs.traversal = ms(prof_mapdraw) - fs.cell_draw;
+    fs.queue_sort = ms(prof_sort);
+    fs.rasterize = ms(prof_rasterize);
+    fs.total = t / 1e6;
+    fs.cells_drawn = cells_drawn;
+    fs.draw_items = isize(ptds);
+    #if CAP_GL
+    fs.draw_calls = poly_draw_calls + instanced_draws;
+    fs.instanced_draws = instanced_draws;
+    fs.instanced_polys = instanced_polys;
+    #else
+    fs.draw_calls = fs.instanced_draws = fs.instanced_polys = 0;
+    #endif
+    fs.patches_culled = patches_culled;
+    fs.cells_culled = cells_culled;
+    fs.allocations = allocs == -1 ? -1 : get_alloc_count() - allocs;
+    fs.range_reduction = governor::reductions(governor::kRange);
+    fs.detail_reduction = governor::reductions(governor::kDetail);
+    fs.line_reduction = governor::reductions(governor::kLines);
+    stats.push_back(fs);
+    rollback();
+    }
+  rb.reset();
+  lastticks = ticks = SDL_GetTicks();
+  return stats;
+  }
+
+/** the average of the frames, without the first one, which also generates the map */
+frame_stats average_stats(const vector<frame_stats>& stats) {
+  int n = isize(stats);
+  frame_stats avg = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+  int qty = max(n-1, 1);
+  for(int i=n-qty; i<n; i++) {
+    auto& fs = stats[i];
+    avg.traversal += fs.traversal / qty;
+    avg.cell_draw += fs.cell_draw / qty;
+    avg.queue_sort += fs.queue_sort / qty;
+    avg.rasterize += fs.rasterize / qty;
+    avg.submit += fs.submit / qty;
+    avg.total += fs.total / qty;
+    avg.cells_drawn += fs.cells_drawn;
+    avg.draw_items += fs.draw_items;
+    avg.draw_calls += fs.draw_calls;
+    avg.instanced_draws += fs.instanced_draws;
+    avg.instanced_polys += fs.instanced_polys;
+    avg.patches_culled += fs.patches_culled;
+    avg.cells_culled += fs.cells_culled;
+    avg.allocations += fs.allocations;
+    }
+  avg.cells_drawn /= qty; avg.draw_items /= qty; avg.allocations /= qty;
+  avg.draw_calls /= qty; avg.instanced_draws /= qty; avg.instanced_polys /= qty;
+  avg.patches_culled /= qty; avg.cells_culled /= qty;
+  /* for the governor, report the final reductions */
+  avg.range_reduction = stats.back().range_reduction;
+  avg.detail_reduction = stats.back().detail_reduction;
+  avg.line_reduction = stats.back().line_reduction;
+  return avg;
+  }
+
+/** render n frames as in render_frames, and print the time spent in each stage of drawing, as JSON */
+EX void bench_frames(int n) {
+  if(n <= 0) return;
+  auto stats = render_frames(n);
+  auto avg = average_stats(stats);
+
+  auto print_stats = [] (const frame_stats& fs) {
+    print(hlog, format("{\"traversal_ms\": %.3f, \"cell_draw_ms\": %.3f, \"queue_sort_ms\": %.3f, \"rasterize_ms\": %.3f, \"total_ms\": %.3f, ",
+      fs.traversal, fs.cell_draw, fs.queue_sort, fs.rasterize, fs.total));
+    print(hlog, format("\"cells_drawn\": %d, \"draw_items\": %d, \"allocations\": %lld, ", fs.cells_drawn, fs.draw_items, fs.allocations));
+    print(hlog, format("\"submit_ms\": %.3f, \"draw_calls\": %d, \"instanced_draws\": %d, \"instanced_polys\": %d, ", fs.submit, fs.draw_calls, fs.instanced_draws, fs.instanced_polys));
+    print(hlog, format("\"patches_culled\": %d, \"cells_culled\": %d, ", fs.patches_culled, fs.cells_culled));
+    print(hlog, format("\"range_reduction\": %d, \"detail_reduction\": %d, \"line_reduction\": %d}", fs.range_reduction, fs.detail_reduction, fs.line_reduction));
+    };
+
+  println(hlog, "{\"geometry\": \"", ginf[geometry].tiling_name, "\", \"width\": ", shot::shotx, ", \"height\": ", shot::shoty,
+    ", \"opengl\": ", vid.usingGL ? "true" : "false", ", \"frame_budget_ms\": ", governor::target_ms, ", \"frames\": [");
+  for(int i=0; i<n; i++) {
+    print(hlog, "  ");
+    print_stats(stats[i]);
+    println(hlog, i < n-1 ? "," : "");
+    }
+  print(hlog, "  ], \"average\": ");
+  print_stats(avg);
+  println(hlog, "}");
+  }
+
+/** compare the ways of submitting the polygons to OpenGL: client arrays, the resident vertex buffer, and the resident buffer with instanced draws */
+EX void bench_instancing(int n) {
+  if(n <= 0) return;
+  #if CAP_GL
+  dynamicval<bool> dr(glhr::resident_buffer, glhr::resident_buffer);
+  #if CAP_INSTANCING
+  dynamicval<bool> di(instancing, instancing);
+  #endif
+  /* the map keeps being generated during the first runs, so they would draw fewer cells */
+  render_frames(n);
+  println(hlog, format("%-22s %10s %10s %10s %10s %10s %10s", "path", "submit ms", "raster ms", "total ms", "calls", "instanced", "polys"));
+  for(int mode=0; mode<3; mode++) {
+    glhr::resident_buffer = mode >= 1;
+    glhr::store_in_buffer(cgi.ourshape);
+    #if CAP_INSTANCING
+    instancing = mode >= 2;
+    #else
+    if(mode == 2) break;
+    #endif
+    auto avg = average_stats(render_frames(n));
+    println(hlog, format("%-22s %10.3f %10.3f %10.3f %10d %10d %10d", mode == 0 ? "client arrays" : mode == 1 ? "resident buffer" : "resident + instanced",
+      avg.submit, avg.rasterize, avg.total, avg.draw_calls, avg.instanced_draws, avg.instanced_polys));
+    }
+  glhr::store_in_buffer(cgi.ourshape);
+  #endif
+  }
+
 void display_animation() {
   if(ma == maCircle && (circle_display_color & 0xFF)) {
     for(int s=0; s<10; s++) {
@@ -1033,6 +1203,23 @@ int readArgs() {
     PHASE(3); shift(); noframes = argi();
     shift(); animfile = args(); record_animation();
     }
+  else if(argis("-benchframes")) {
+    PHASE(3); shift(); start_game(); bench_frames(argi());
+    }
+  else if(argis("-bench-instancing")) {
+    PHASE(3); shift(); start_game(); bench_instancing(argi());
+    }
+  #if CAP_GL
+  else if(argis("-gl-resident")) {
+    PHASEFROM(2); shift(); glhr::resident_buffer = argi();
+    glhr::store_in_buffer(cgi.ourshape);
+    }
+  #endif
+  #if CAP_INSTANCING
+  else if(argis("-gl-instancing")) {
+    PHASEFROM(2); shift(); instancing = argi();
+    }
+  #endif
   else if(argis("-record-only")) {
     PHASEFROM(2); 
     shift(); min_frame = argi();
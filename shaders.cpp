@@ -16,8 +16,10 @@ constexpr flagtype GF_TEXTURE  = 1;
 constexpr flagtype GF_VARCOLOR = 2;
 constexpr flagtype GF_LIGHTFOG = 4;
 constexpr flagtype GF_LEVELS   = 8;
+/** the model matrix comes per instance, from the aInstance attribute, and is applied before uMV */
+constexpr flagtype GF_INSTANCED = 16;
 
-constexpr flagtype GF_which    = 15;
+constexpr flagtype GF_which    = 31;
 
 constexpr flagtype SF_PERS3        = 256;
 constexpr flagtype SF_BAND         = 512;
@@ -36,6 +38,8 @@ constexpr flagtype SF_ZFOG         = 65536;
 constexpr int aPosition = 0;
 constexpr int aColor = 3;
 constexpr int aTexture = 8;
+/** a mat4 attribute, uses the locations aInstance ... aInstance+3 */
+constexpr int aInstance = 4;
 
 /* texture bindings */
 constexpr int INVERSE_EXP_BINDING = 2;
@@ -58,6 +62,11 @@ shared_ptr<glhr::GLprogram> write_shader(flagtype shader_flags) {
   string varying, vsh, fsh, vmain = "void main() {\n", fmain = "void main() {\n";
 
   vsh += "attribute mediump vec4 aPosition;\n";
+  string position = "aPosition";
+  if(shader_flags & GF_INSTANCED) {
+    vsh += "attribute mediump mat4 aInstance;\n";
+    position = "(aInstance * aPosition)";
+    }
   varying += "varying mediump vec4 vColor;\n";
 
   fmain += "gl_FragColor = vColor;\n";
@@ -99,7 +108,7 @@ shared_ptr<glhr::GLprogram> write_shader(flagtype shader_flags) {
   bool skip_t = false;
   
   if(pmodel == mdPixel) {
-    vmain += "vec4 pos = aPosition; pos[3] = 1.0;\n";
+    vmain += "vec4 pos = " + position + "; pos[3] = 1.0;\n";
     vmain += "pos = uMV * pos;\n";
     if(shader_flags & GF_LEVELS) vmain += "vPos = pos;\n";  
     vmain += "gl_Position = uP * pos;\n";
@@ -107,7 +116,7 @@ shared_ptr<glhr::GLprogram> write_shader(flagtype shader_flags) {
     shader_flags |= SF_PIXELS | SF_DIRECT;
     }
   else if(pmodel == mdManual) {
-    vmain += "vec4 pos = uMV * aPosition;\n";
+    vmain += "vec4 pos = uMV * " + position + ";\n";
     if(shader_flags & GF_LEVELS)
       vmain += "vPos = pos;\n";
     vmain += "gl_Position = uP * pos;\n";
@@ -235,7 +244,7 @@ shared_ptr<glhr::GLprogram> write_shader(flagtype shader_flags) {
     }
 
   if(!skip_t) {
-    vmain += "vec4 t = uMV * aPosition;\n";
+    vmain += "vec4 t = uMV * " + position + ";\n";
     vmain += coordinator;
     if(distfun != "") {
       vmain += "float fogs = (uFogBase - " + distfun + " / uFog);\n";
@@ -486,7 +495,8 @@ EX flagtype get_shader_flags() {
   return glhr::current_glprogram->shader_flags;
   }
 
-EX void glapplymatrix(const transmatrix& V) {
+/** V as a matrix for the shaders, as used by glapplymatrix and for the instanced draws */
+EX glhr::glmatrix glmatrix_of(const transmatrix& V) {
   GLfloat mat[16];
   int id = 0;
   
@@ -504,7 +514,11 @@ EX void glapplymatrix(const transmatrix& V) {
     for(int y=0; y<4; y++) 
       for(int x=0; x<4; x++) mat[id++] = V[x][y];
     }
-  glhr::set_modelview(glhr::as_glmatrix(mat));
+  return glhr::as_glmatrix(mat);
+  }
+
+EX void glapplymatrix(const transmatrix& V) {
+  glhr::set_modelview(glmatrix_of(V));
   }
 
 
@@ -0,0 +1,273 @@
+// Hyperbolic Rogue -- persistent cache of the prepared shapes
+// Copyright (C) 2011-2020 Zeno Rogue, see 'hyper.cpp' for details
+
+/** \file shapecache.cpp
+ *  \brief save the result of geometry_information::prepare_shapes on disk, and load it instead of rebuilding
+ *
+ *  The cache file for a geometry is named after a hash of the key computed by check_cgi (together with
+ *  the format version and the game version), and contains the key itself, so that collisions and stale
+ *  files are detected. Loading maps the file into memory and copies the data into the vectors of the
+ *  geometry_information, which are then used exactly as if the shapes had been built.
+ */
+
+#include "hyper.h"
+namespace hr {
+
+EX namespace shapecache {
+
+/** the directory where the shape cache is stored; empty = the cache is off */
+EX string dir;
+
+/** increase when the format of the cache files, or anything computed by prepare_shapes, changes */
+const int format_version = 1;
+
+/** the geometries whose shapes depend on things which are not saved: irregular maps are randomly generated, and hybrid geometries build their walls lazily */
+EX bool available() {
+  return dir != "" && !IRREGULAR && !hybri;
+  }
+
+#if CAP_SHAPECACHE
+
+string key_of(geometry_information& g) {
+  for(auto& p: cgis) if(&p.second == &g) {
+    shstream ss;
+    print(ss, "HRSC ", format_version, " ", VER, "; ", p.first, "T: ", ginf[geometry].tiling_name, "; S: ", S3, ",", S7, "; FT: ", floor_textures ? 1 : 0);
+    print(ss, "; sizes: ", int(sizeof(ld)), ",", int(sizeof(hyperpoint)), ",", int(sizeof(hpcshape)), ",", int(sizeof(transmatrix)), ",", int(sizeof(glvertex)));
+    return ss.s;
+    }
+  return "";
+  }
+
+string filename_of(const string& key) {
+  /* FNV-1a */
+  unsigned long long h = 14695981039346656037ull;
+  for(char c: key) { h ^= (unsigned char) c; h *= 1099511628211ull; }
+  char buf[32];
+  snprintf(buf, 32, "%016llx", h);
+  return dir + "/" + buf + ".hrsc";
+  }
+
+/** reads the mapped file, with bounds checks */
+struct mapped_hstream : hstream {
+  const char *p, *end;
+  size_t left() { return end - p; }
+  virtual void write_char(char c) override { throw hstream_exception(); }
+  virtual char read_char() override { char c; read_chars(&c, 1); return c; }
+  virtual void read_chars(char* c, size_t q) override {
+    if(q > left()) throw hstream_exception();
+    memcpy(c, p, q); p += q;
+    }
+  };
+
+/** the same code is used for saving and loading */
+struct serializer {
+  geometry_information& g;
+  hstream& hs;
+  mapped_hstream *in;
+
+  serializer(geometry_information& g, hstream& hs, mapped_hstream *in) : g(g), hs(hs), in(in) {}
+
+  template<class T> void raw(T& t) {
+    if(in) hread_raw(hs, t); else hwrite_raw(hs, t);
+    }
+
+  template<class T> void pod(vector<T>& v) {
+    int n = isize(v);
+    raw(n);
+    if(in) {
+      if(n < 0 || size_t(n) > in->left() / sizeof(T)) throw hstream_exception();
+      v.resize(n);
+      }
+    if(n && in) hs.read_chars((char*) &v[0], n * sizeof(T));
+    else if(n) hs.write_chars((const char*) &v[0], n * sizeof(T));
+    }
+
+  /** texture info pointers are saved as: -1 = none, -2 = models_texture, k = floor_texture_vertices[k];
+   *  anything else comes from the uninitialized shapes which are not used in the current geometry, and is loaded as none
+   */
+  void tinf(basic_textureinfo*& t) {
+    int k;
+    if(!in) {
+      if(t == nullptr) k = -1;
+      else if(t == &g.models_texture) k = -2;
+      else if(!floor_texture_vertices.empty() && t >= &floor_texture_vertices[0] && t < &floor_texture_vertices[0] + isize(floor_texture_vertices))
+        k = t - &floor_texture_vertices[0];
+      else k = -3;
+      }
+    raw(k);
+    if(in) {
+      if(k == -1 || k == -3) t = nullptr;
+      else if(k == -2) t = &g.models_texture;
+      else if(k >= 0 && k < isize(floor_texture_vertices)) t = &floor_texture_vertices[k];
+      else throw hstream_exception();
+      }
+    }
+
+  void shape(hpcshape& sh) {
+    raw(sh.s); raw(sh.e); raw(sh.prio); raw(sh.flags); raw(sh.intester);
+    tinf(sh.tinf);
+    raw(sh.texture_offset); raw(sh.shs); raw(sh.she);
+    }
+
+  void shapes(hpcshape *sh, int q) { for(int i=0; i<q; i++) shape(sh[i]); }
+
+  void shapes(vector<hpcshape>& v) {
+    int n = isize(v);
+    raw(n);
+    if(in) {
+      if(n < 0 || size_t(n) > in->left()) throw hstream_exception();
+      v.resize(n);
+      }
+    for(auto& sh: v) shape(sh);
+    }
+
+  void fshape(floorshape& fsh) {
+    raw(fsh.shapeid); raw(fsh.id); raw(fsh.pstrength); raw(fsh.fstrength); raw(fsh.prio);
+    shapes(fsh.b); shapes(fsh.shadow);
+    for(int i=0; i<SIDEPARS; i++) shapes(fsh.side[i]);
+    for(int i=0; i<SIDEPARS; i++) for(int j=0; j<MAX_EDGE; j++) shapes(fsh.gpside[i][j]);
+    for(int i=0; i<SIDEPARS; i++) shapes(fsh.levels[i]);
+    for(int i=0; i<2; i++) shapes(fsh.cone[i]);
+    }
+
+  void all() {
+    /* the shapes declared directly in geometry_information, from shSemiFloorSide to shAnimatedBat2 */
+    hpcshape *first = &g.shSemiFloorSide[0];
+    char *last = (char*) (&g.shAnimatedBat2 + 1);
+    if((last - (char*) first) % sizeof(hpcshape)) throw hstream_exception();
+    shapes(first, (hpcshape*) last - first);
+    shapes(g.shFullCross, 2);
+
+    shapes(g.shPlainWall3D); shapes(g.shWireframe3D); shapes(g.shWall3D); shapes(g.shMiniWall3D);
+    pod(g.walltester); pod(g.wallstart); pod(g.raywall); pod(g.walloffsets); pod(g.symmetriesAt);
+
+    for(auto fsh: g.all_plain_floorshapes) { fshape(*fsh); raw(fsh->rad0); raw(fsh->rad1); }
+    for(auto fsh: g.all_escher_floorshapes) { fshape(*fsh); raw(fsh->scale); }
+
+    raw(g.dlow_table); raw(g.dhi_table); raw(g.dfloor_table); raw(g.validsidepar);
+    raw(g.sword_size); raw(g.corner_bonus); raw(g.asteroid_size); raw(g.wormscale); raw(g.tentacle_length);
+    raw(g.SD3); raw(g.SD6); raw(g.SD7); raw(g.S12); raw(g.S14); raw(g.S21); raw(g.S28); raw(g.S42); raw(g.S36); raw(g.S84);
+
+    pod(g.hpc);
+    pod(g.models_texture.tvertices);
+
+    int endmark = 0x43535248;
+    raw(endmark);
+    if(endmark != 0x43535248) throw hstream_exception();
+    }
+  };
+
+/** a partially read file may have filled some vectors which prepare_shapes does not clear itself */
+void reset(geometry_information& g) {
+  for(auto v: {&g.shPlainWall3D, &g.shWireframe3D, &g.shWall3D, &g.shMiniWall3D}) v->clear();
+  g.walltester.clear(); g.wallstart.clear(); g.raywall.clear(); g.walloffsets.clear();
+  g.models_texture.tvertices.clear();
+  auto clear = [] (floorshape& fsh) {
+    fsh.b.clear(); fsh.shadow.clear();
+    for(auto& v: fsh.side) v.clear();
+    for(auto& a: fsh.gpside) for(auto& v: a) v.clear();
+    for(auto& v: fsh.levels) v.clear();
+    for(auto& v: fsh.cone) v.clear();
+    };
+  for(auto fsh: g.all_plain_floorshapes) clear(*fsh);
+  for(auto fsh: g.all_escher_floorshapes) clear(*fsh);
+  }
+#endif
+
+/** try to load the shapes of g from the cache; called by prepare_shapes */
+EX bool load(geometry_information& g) {
+  #if CAP_SHAPECACHE
+  if(!available()) return false;
+  string key = key_of(g);
+  if(key == "") return false;
+  string fname = filename_of(key);
+  auto t0 = profile_clock();
+  int fd = open(fname.c_str(), O_RDONLY);
+  if(fd < 0) return false;
+  struct stat st;
+  void *map = MAP_FAILED;
+  if(fstat(fd, &st) == 0 && st.st_size > 0)
+    map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(map == MAP_FAILED) return false;
+
+  mapped_hstream ms;
+  ms.p = (const char*) map; ms.end = ms.p + st.st_size;
+  bool ok = true, started = false;
+  try {
+    string s;
+    int len = ms.get<int>();
+    if(len != isize(key) || len > int(ms.left())) throw hstream_exception();
+    s.resize(len); ms.read_chars(&s[0], len);
+    if(s != key) throw hstream_exception();
+    g.init_floorshapes();
+    started = true;
+    serializer(g, ms, &ms).all();
+    }
+  catch(hstream_exception& e) { ok = false; }
+  munmap(map, st.st_size);
+
+  if(!ok) {
+    if(started) reset(g);
+    DEBB(DF_POLY, ("shape cache: ", fname, " is not valid"));
+    return false;
+    }
+  g.last = nullptr;
+  g.prehpc = isize(g.hpc);
+  g.initPolyForGL();
+  DEBB(DF_POLY, ("shape cache: loaded ", fname, " (", isize(g.hpc), " vertices) in ", (profile_clock() - t0) / 1e6, " ms"));
+  return true;
+  #else
+  return false;
+  #endif
+  }
+
+/** save the shapes of g to the cache; called by prepare_shapes after the shapes have been built */
+EX void save(geometry_information& g) {
+  #if CAP_SHAPECACHE
+  if(!available()) return;
+  string key = key_of(g);
+  if(key == "") return;
+  string fname = filename_of(key);
+  auto t0 = profile_clock();
+  mkdir(dir.c_str(), 0777);
+  /* write to a temporary file first, so that other instances never see a partial file */
+  string tmpname = fname + "." + its(getpid()) + ".tmp";
+  bool ok = true;
+  {
+  fhstream f(tmpname, "wb");
+  if(!f.f) return;
+  try {
+    int len = isize(key);
+    f.write(len); f.write_chars(key.c_str(), len);
+    serializer(g, f, nullptr).all();
+    }
+  catch(hstream_exception& e) { ok = false; }
+  if(fflush(f.f)) ok = false;
+  }
+  if(ok) ok = rename(tmpname.c_str(), fname.c_str()) == 0;
+  if(!ok) {
+    unlink(tmpname.c_str());
+    DEBB(DF_POLY, ("shape cache: could not save ", fname));
+    return;
+    }
+  DEBB(DF_POLY, ("shape cache: saved ", fname, " in ", (profile_clock() - t0) / 1e6, " ms"));
+  #endif
+  }
+
+#if CAP_COMMANDLINE
+int read_args() {
+  using namespace arg;
+  if(0) ;
+  else if(argis("-shapecache")) {
+    shift(); dir = args();
+    }
+  else return 1;
+  return 0;
+  }
+
+auto ah = addHook(hooks_args, 0, read_args);
+#endif
+
+EX }
+}
@@ -0,0 +1,331 @@
+// Hyperbolic Rogue -- tile-parallel software rasterizer
+// Copyright (C) 2011-2020 Zeno Rogue, see 'hyper.cpp' for details
+
+/** \file swrender.cpp
+ *  \brief tile-parallel software rasterizer
+ *
+ *  Without OpenGL, polygons are normally drawn one by one with SDL_gfx. When swrender::threads is set,
+ *  dqi_poly::draw passes the projected polygons to this rasterizer instead. They are binned into
+ *  screen tiles, and the tiles are drawn in parallel, with anti-aliasing and alpha blending. Within each
+ *  tile the polygons are drawn in the order of the draw queue, so the result does not depend on threads.
+ */
+
+#include "hyper.h"
+#if CAP_THREAD
+#include <thread>
+#include <atomic>
+#endif
+
+namespace hr {
+
+EX namespace swrender {
+
+/** number of threads used by the rasterizer; 0 means that polygons are drawn with SDL_gfx */
+EX int threads = 0;
+
+/** the size of screen tiles, in pixels */
+EX int tile_size = 64;
+
+/** every pixel row is sampled at this many heights */
+static const int SUBSAMPLES = 4;
+
+#if CAP_SDL
+struct swedge { float x0, y0, x1, y1; };
+
+/** a polygon waiting to be rasterized; fill edges are [fill0, fill1) and outline segments are [fill1, line1) in edges */
+struct swpoly {
+  int fill0, fill1, line1;
+  color_t fill, outline;
+  float halfwidth;
+  int x0, y0, x1, y1;
+  };
+
+vector<swedge> edges;
+vector<swpoly> polys;
+vector<vector<int>> tiles;
+int tiles_x, tiles_y;
+
+/** buffers used by one thread */
+struct scratch {
+  vector<float> cover, run, xs;
+  vector<swedge> part_edges, row_edges;
+  };
+
+EX bool active() {
+  return threads && !vid.usingGL && s && !current_display->stereo_active();
+  }
+
+/** add a polygon given in glcoords (screen coordinates relative to the center); if inverse, everything outside it is filled */
+EX void add_polygon(const vector<glvertex>& v, color_t fill, color_t outline, ld linewidth, bool inverse, bool fat) {
+  int n = isize(v);
+  if(!n) return;
+  if(!(fill & 0xFF)) fill = 0;
+  if(!(outline & 0xFF)) outline = 0;
+  if(!fill && !outline) return;
+
+  swpoly p;
+  p.fill = fill; p.outline = outline;
+  p.halfwidth = max<ld>(linewidth, 1) / 2;
+
+  float cx = current_display->xcenter, cy = current_display->ycenter;
+  float xmin = 1e9, xmax = -1e9, ymin = 1e9, ymax = -1e9;
+  for(auto& h: v) {
+    xmin = min(xmin, cx + h[0]); xmax = max(xmax, cx + h[0]);
+    ymin = min(ymin, cy + h[1]); ymax = max(ymax, cy + h[1]);
+    }
+  if(fat && xmax > xmin + 20) p.halfwidth = max(p.halfwidth, 1.5f);
+
+  p.fill0 = isize(edges);
+  if(fill) {
+    for(int i=0; i<n; i++) {
+      auto& a = v[i]; auto& b = v[(i+1) % n];
+      edges.push_back(swedge{cx + a[0], cy + a[1], cx + b[0], cy + b[1]});
+      }
+    if(inverse) {
+      float W = s->w, H = s->h;
+      edges.push_back(swedge{0, 0, W, 0});
+      edges.push_back(swedge{W, 0, W, H});
+      edges.push_back(swedge{W, H, 0, H});
+      edges.push_back(swedge{0, H, 0, 0});
+      }
+    }
+  p.fill1 = isize(edges);
+  if(outline)
+    for(int i=1; i<n; i++)
+      edges.push_back(swedge{cx + v[i-1][0], cy + v[i-1][1], cx + v[i][0], cy + v[i][1]});
+  p.line1 = isize(edges);
+
+  if(fill && inverse) xmin = ymin = -1e9, xmax = ymax = 1e9;
+  float margin = p.halfwidth + 1;
+  p.x0 = max<float>(0, floor(xmin - margin)); p.x1 = min<float>(s->w, ceil(xmax + margin));
+  p.y0 = max<float>(0, floor(ymin - margin)); p.y1 = min<float>(s->h, ceil(ymax + margin));
+  if(p.x0 >= p.x1 || p.y0 >= p.y1) { edges.resize(p.fill0); return; }
+  polys.push_back(p);
+  }
+
+/** blend col (0xRRGGBBAA, as in SDL_gfx) into pix, with the alpha multiplied by coverage */
+inline void blend(color_t& pix, color_t col, float coverage) {
+  int a = int((col & 0xFF) * coverage + .5);
+  if(a <= 0) return;
+  int na = 255 - a;
+  color_t r = (((col >> 24) & 0xFF) * a + ((pix >> 16) & 0xFF) * na) / 255;
+  color_t g = (((col >> 16) & 0xFF) * a + ((pix >> 8) & 0xFF) * na) / 255;
+  color_t b = (((col >> 8) & 0xFF) * a + (pix & 0xFF) * na) / 255;
+  color_t pa = pix >> 24;
+  pa += (255 - pa) * a / 255;
+  pix = (pa << 24) | (r << 16) | (g << 8) | b;
+  }
+
+inline color_t *pixel_row(int y) { return (color_t*) ((char*) s->pixels + y * s->pitch); }
+
+/** fill the part of p in [xa,xb) x [ya,yb), using the even-odd rule */
+void fill_part(const swpoly& p, int xa, int xb, int ya, int yb, scratch& sc) {
+  int w = xb - xa;
+  auto& cover = sc.cover;
+  auto& run = sc.run;
+  auto& xs = sc.xs;
+  const float ws = 1. / SUBSAMPLES;
+  cover.assign(w + 1, 0); run.assign(w + 1, 0);
+
+  /* only the edges crossing this part, and then only the edges crossing the current row, are tested */
+  auto& part_edges = sc.part_edges;
+  auto& row_edges = sc.row_edges;
+  part_edges.clear();
+  for(int e=p.fill0; e<p.fill1; e++) {
+    auto& ed = edges[e];
+    if(max(ed.y0, ed.y1) >= ya && min(ed.y0, ed.y1) <= yb && ed.y0 != ed.y1) part_edges.push_back(ed);
+    }
+
+  for(int y=ya; y<yb; y++) {
+    row_edges.clear();
+    for(auto& ed: part_edges)
+      if(max(ed.y0, ed.y1) >= y && min(ed.y0, ed.y1) <= y+1) row_edges.push_back(ed);
+    if(row_edges.empty()) continue;
+    int lo = w, hi = -1;
+    for(int sub=0; sub<SUBSAMPLES; sub++) {
+      float sy = y + (sub + .5f) * ws;
+      xs.clear();
+      for(auto& ed: row_edges)
+        if((ed.y0 <= sy) != (ed.y1 <= sy))
+          xs.push_back(ed.x0 + (sy - ed.y0) * (ed.x1 - ed.x0) / (ed.y1 - ed.y0) - xa);
+      sort(xs.begin(), xs.end());
+      for(int k=0; k+1<isize(xs); k+=2) {
+        float a = max<float>(xs[k], 0), b = min<float>(xs[k+1], w);
+        if(a >= b) continue;
+        int ia = int(a), ib = int(b);
+        lo = min(lo, ia); hi = max(hi, ib);
+        if(ia == ib) { cover[ia] += (b - a) * ws; continue; }
+        cover[ia] += (ia + 1 - a) * ws;
+        run[ia+1] += ws; run[ib] -= ws;
+        cover[ib] += (b - ib) * ws;
+        }
+      }
+    if(hi < 0) continue;
+    color_t *row = pixel_row(y) + xa;
+    float acc = 0;
+    for(int i=lo; i<=hi && i<w; i++) {
+      acc += run[i];
+      float c = acc + cover[i];
+      if(c > 1e-3) blend(row[i], p.fill, min(c, 1.f));
+      }
+    for(int i=lo; i<=hi; i++) cover[i] = run[i] = 0;
+    }
+  }
+
+/** draw the outline of p in [xa,xb) x [ya,yb) */
+void outline_part(const swpoly& p, int xa, int xb, int ya, int yb) {
+  float hw = p.halfwidth, margin = hw + 1;
+  for(int e=p.fill1; e<p.line1; e++) {
+    auto& ed = edges[e];
+    int sx0 = max<float>(xa, floor(min(ed.x0, ed.x1) - margin)), sx1 = min<float>(xb, ceil(max(ed.x0, ed.x1) + margin));
+    int sy0 = max<float>(ya, floor(min(ed.y0, ed.y1) - margin)), sy1 = min<float>(yb, ceil(max(ed.y0, ed.y1) + margin));
+    if(sx0 >= sx1 || sy0 >= sy1) continue;
+    float dx = ed.x1 - ed.x0, dy = ed.y1 - ed.y0;
+    float len2 = dx*dx + dy*dy;
+    auto at = [&] (int x, int y) {
+      float px = x + .5f - ed.x0, py = y + .5f - ed.y0;
+      float t = len2 > 0 ? min(max((px*dx + py*dy) / len2, 0.f), 1.f) : 0;
+      float ex = px - t*dx, ey = py - t*dy;
+      float c = hw + .5f - sqrt(ex*ex + ey*ey);
+      if(c > 0) blend(pixel_row(y)[x], p.outline, min(c, 1.f));
+      };
+    /* walk along the major axis, so that only the pixels close to the segment are tested */
+    float spread = margin * sqrt(len2) / max(max(abs(dx), abs(dy)), 1e-3f) + 1;
+    if(abs(dx) >= abs(dy)) {
+      for(int x=sx0; x<sx1; x++) {
+        float t = dx ? min(max((x + .5f - ed.x0) / dx, 0.f), 1.f) : 0;
+        float yc = ed.y0 + t * dy;
+        int y0 = max<float>(sy0, floor(yc - spread)), y1 = min<float>(sy1, ceil(yc + spread));
+        for(int y=y0; y<y1; y++) at(x, y);
+        }
+      }
+    else {
+      for(int y=sy0; y<sy1; y++) {
+        float t = min(max((y + .5f - ed.y0) / dy, 0.f), 1.f);
+        float xc = ed.x0 + t * dx;
+        int x0 = max<float>(sx0, floor(xc - spread)), x1 = min<float>(sx1, ceil(xc + spread));
+        for(int x=x0; x<x1; x++) at(x, y);
+        }
+      }
+    }
+  }
+
+void draw_tile(int t, scratch& sc) {
+  int tx0 = (t % tiles_x) * tile_size, ty0 = (t / tiles_x) * tile_size;
+  int tx1 = min(tx0 + tile_size, s->w), ty1 = min(ty0 + tile_size, s->h);
+  for(int id: tiles[t]) {
+    auto& p = polys[id];
+    int xa = max(tx0, p.x0), xb = min(tx1, p.x1);
+    int ya = max(ty0, p.y0), yb = min(ty1, p.y1);
+    if(p.fill1 > p.fill0) fill_part(p, xa, xb, ya, yb, sc);
+    if(p.line1 > p.fill1) outline_part(p, xa, xb, ya, yb);
+    }
+  }
+
+/** rasterize all the polygons added so far; called before anything else is drawn on s */
+EX void flush() {
+  if(polys.empty()) return;
+  tiles_x = (s->w + tile_size - 1) / tile_size;
+  tiles_y = (s->h + tile_size - 1) / tile_size;
+  int qty = tiles_x * tiles_y;
+  tiles.resize(qty);
+  for(auto& t: tiles) t.clear();
+  for(int i=0; i<isize(polys); i++) {
+    auto& p = polys[i];
+    for(int ty = p.y0 / tile_size; ty <= (p.y1-1) / tile_size; ty++)
+    for(int tx = p.x0 / tile_size; tx <= (p.x1-1) / tile_size; tx++)
+      tiles[ty * tiles_x + tx].push_back(i);
+    }
+
+  SDL_LockSurface(s);
+  #if CAP_THREAD
+  if(threads > 1 && qty > 1) {
+    std::atomic<int> next(0);
+    auto work = [&] {
+      scratch sc;
+      while(true) {
+        int t = next++;
+        if(t >= qty) return;
+        draw_tile(t, sc);
+        }
+      };
+    vector<std::thread> workers;
+    for(int i=1; i<threads; i++) workers.emplace_back(work);
+    work();
+    for(auto& w: workers) w.join();
+    }
+  else
+  #endif
+    {
+    scratch sc;
+    for(int t=0; t<qty; t++) draw_tile(t, sc);
+    }
+  SDL_UnlockSurface(s);
+
+  polys.clear();
+  edges.clear();
+  }
+
+/** render the current screen both with SDL_gfx and with the rasterizer, and compare the images */
+EX void image_diff_test() {
+  if(!threads) threads = 1;
+  resetbuffer rb;
+  dynamicval<bool> dgl(vid.usingGL, false);
+  calcparam();
+  models::configure();
+  renderbuffer buf0(vid.xres, vid.yres, false), buf1(vid.xres, vid.yres, false);
+  SDL_Surface *img[2];
+  int ticks[2];
+  for(int i=0; i<2; i++) {
+    auto& buf = i ? buf1 : buf0;
+    dynamicval<int> dt(threads, i ? threads : 0);
+    buf.enable();
+    current_display->set_viewport(0);
+    buf.clear(backcolor);
+    int t0 = SDL_GetTicks();
+    drawfullmap();
+    ticks[i] = SDL_GetTicks() - t0;
+    img[i] = buf.render();
+    }
+  rb.reset();
+
+  int differ = 0;
+  double total = 0;
+  for(int y=0; y<vid.yres; y++)
+  for(int x=0; x<vid.xres; x++) {
+    color_t c0 = qpixel(img[0], x, y), c1 = qpixel(img[1], x, y);
+    int worst = 0;
+    for(int p=0; p<3; p++) {
+      int d = abs(part(c0, p) - part(c1, p));
+      total += d; worst = max(worst, d);
+      }
+    if(worst > 64) differ++;
+    }
+  int qty = vid.xres * vid.yres;
+  println(hlog, format("swrender: SDL_gfx %d ms, %d threads %d ms; %d of %d pixels (%.2f%%) differ, mean difference %.3f",
+    ticks[0], threads, ticks[1], differ, qty, differ * 100. / qty, total / qty / 3));
+  println(hlog, differ <= qty / 50 ? "swrender image diff: OK" : "swrender image diff: FAILED");
+  }
+#endif
+
+#if CAP_COMMANDLINE
+auto ah_swrender = addHook(hooks_args, 0, [] () {
+  using namespace arg;
+  if(argis("-swthreads")) {
+    PHASEFROM(2); shift(); threads = argi();
+    }
+  else if(argis("-swtile")) {
+    PHASEFROM(2); shift(); tile_size = max(argi(), 8);
+    }
+  #if CAP_SDL
+  else if(argis("-swdiff")) {
+    PHASE(3); start_game(); image_diff_test();
+    }
+  #endif
+  else return 1;
+  return 0;
+  });
+#endif
+
+EX }
+}
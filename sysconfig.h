@@ -193,6 +193,31 @@
 #define CAP_PROFILING 0
 #endif
 
+/** count memory allocations, for benchmarks */
+#ifndef CAP_COUNT_ALLOCS
+#define CAP_COUNT_ALLOCS (!ISMOBILE && !ISWEB)
+#endif
+
+/** keep the prepared shapes in a cache on disk (see shapecache.cpp) */
+#ifndef CAP_SHAPECACHE
+#define CAP_SHAPECACHE (CAP_FILES && CAP_SHAPES && !ISMOBWEB && !ISWINDOWS)
+#endif
+
+/** keep the binaries of the compiled shader programs in a cache on disk (see progcache.cpp) */
+#ifndef CAP_PROGCACHE
+#define CAP_PROGCACHE (CAP_SHADER && CAP_FILES && !ISMOBWEB && !ISWINDOWS && !ISMAC)
+#endif
+
+/** map the geodesic tables of Sol-like geometries from their files instead of reading them (see nonisotropic.cpp) */
+#ifndef CAP_MMAP_TABLES
+#define CAP_MMAP_TABLES (CAP_FILES && !ISMOBWEB && !ISWINDOWS)
+#endif
+
+/** draw many copies of the same shape with one instanced draw call (needs OpenGL 3.3) */
+#ifndef CAP_INSTANCING
+#define CAP_INSTANCING (CAP_SHADER && !ISMOBWEB && !ISMAC)
+#endif
+
 #define PSEUDOKEY_WHEELDOWN 2501
 #define PSEUDOKEY_WHEELUP 2502
 #define PSEUDOKEY_RELEASE 2503
@@ -418,6 +443,8 @@ extern "C" {
 #include <random>
 #include <complex>
 #include <new>
+#include <chrono>
+#include <atomic>
 
 #ifdef USE_UNORDERED_MAP
 #include <unordered_map>
@@ -447,6 +474,11 @@ extern "C" {
 #include <sys/stat.h>
 #endif
 
+#if CAP_SHAPECACHE || CAP_MMAP_TABLES
+#include <fcntl.h>
+#include <sys/mman.h>
+#endif
+
 #if CAP_TIMEOFDAY
 #include <sys/time.h>
 #endif
@@ -519,4 +551,21 @@ union SDL_Event;
 #define CAP_MEMORY_RESERVE (!ISMOBILE && !ISWEB)
 #endif
 
+#ifndef CAP_THREAD
+#define CAP_THREAD (!ISMOBILE && !ISWEB)
+#endif
+
+// batched computations use SSE2/AVX when the compiler targets them (e.g., -march=native)
+#ifndef CAP_SIMD
+#if (defined(__SSE2__) || defined(__AVX__)) && !ISWEB && MAXMDIM == 4
+#define CAP_SIMD 1
+#else
+#define CAP_SIMD 0
+#endif
+#endif
+
+#if CAP_SIMD
+#include <immintrin.h>
+#endif
+
 #undef TRANSPARENT
@@ -70,44 +70,76 @@ EX ld ilerp(ld a0, ld a1, ld x) {
 
 // debug utilities
 
-#if CAP_PROFILING
+/** \brief time profiling of the drawing stages
+ *
+ *  profile_start(t) and profile_stop(t) add the time spent between them to the category t of
+ *  the current frame. Nested calls for the same category are counted once. Nothing is measured
+ *  unless 'profiling' is on; CAP_PROFILING turns it on from the start, and -benchframes while benchmarking.
+ */
+
+#if HDR
+enum eProfileCategory {
+  prof_drawthemap, prof_mapdraw, prof_queue, prof_sort, prof_markers, prof_cells, prof_rasterize,
+  prof_categories = 16
+  };
+
+static const int profile_frames = 64;
+#endif
 
-#define FRAMES 64
-#define CATS 16
+EX bool profiling = CAP_PROFILING;
 
-long long proftable[16][FRAMES];
-int pframeid;
+/** time spent in each category in the last profile_frames frames, in nanoseconds */
+EX long long proftable[prof_categories][profile_frames];
+EX int pframeid;
+int profdepth[prof_categories];
 
-void profile_frame() { 
-  pframeid++; pframeid %=  FRAMES;
-  for(int t=0; t<16; t++) proftable[t][pframeid] = 0;
+EX long long profile_clock() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now().time_since_epoch()).count();
   }
 
-EX void profile_start(int t) { proftable[t][pframeid] -= getms(); }
-EX void profile_stop(int t) { proftable[t][pframeid] += getms(); }
+EX void profile_frame() { 
+  if(!profiling) return;
+  pframeid++; pframeid %=  profile_frames;
+  for(int t=0; t<prof_categories; t++) proftable[t][pframeid] = 0;
+  }
+
+EX void profile_start(int t) { if(profiling && !(profdepth[t]++)) proftable[t][pframeid] -= profile_clock(); }
+EX void profile_stop(int t) { if(profiling && profdepth[t] > 0 && !(--profdepth[t])) proftable[t][pframeid] += profile_clock(); }
+
+#if HDR
+struct profile_scope {
+  int t;
+  profile_scope(int t) : t(t) { profile_start(t); }
+  ~profile_scope() { profile_stop(t); }
+  };
+#endif
 
-void profile_info() {
-  for(int t=0; t<16; t++) {
-    sort(proftable[t], proftable[t]+FRAMES);
-    if(proftable[t][FRAMES-1] == 0) continue;
+EX void profile_info() {
+  if(!profiling) return;
+  for(int t=0; t<prof_categories; t++) {
+    sort(proftable[t], proftable[t]+profile_frames);
+    if(proftable[t][profile_frames-1] == 0) continue;
     long long sum = 0;
-    for(int f=0; f<FRAMES; f++) sum += proftable[t][f];
-    printf("Category %d: avg = %Ld, %Ld..%Ld..%Ld..%Ld..%Ld\n",
-      t, sum / FRAMES, proftable[t][0], proftable[t][16], proftable[t][32],
+    for(int f=0; f<profile_frames; f++) sum += proftable[t][f];
+    printf("Category %d: avg = %lld, %lld..%lld..%lld..%lld..%lld\n",
+      t, sum / profile_frames, proftable[t][0], proftable[t][16], proftable[t][32],
       proftable[t][48], proftable[t][63]);
     }
   }
-#endif
 
-#if !CAP_PROFILING
-#if HDR
-#define profile_frame()
-#define profile_start(t)
-#define profile_stop(t)
-#define profile_info()
-#endif
+#if CAP_COUNT_ALLOCS
+/** the number of memory allocations made so far */
+EX std::atomic<long long> alloc_count;
 #endif
 
+EX long long get_alloc_count() {
+  #if CAP_COUNT_ALLOCS
+  return alloc_count.load(std::memory_order_relaxed);
+  #else
+  return -1;
+  #endif
+  }
+
 EX purehookset hooks_tests;
 
 EX string simplify(const string& s) {
@@ -290,3 +322,14 @@ EX string parser_help() {
   }
 
 }
+
+#if CAP_COUNT_ALLOCS
+void* operator new(size_t size) {
+  hr::alloc_count.fetch_add(1, std::memory_order_relaxed);
+  void *p = malloc(size ? size : 1);
+  if(!p) throw std::bad_alloc();
+  return p;
+  }
+
+void operator delete(void *p) noexcept { free(p); }
+#endif